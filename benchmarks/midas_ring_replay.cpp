@@ -0,0 +1,253 @@
+// midas_ring_replay: replays a MIDAS file into a shared-memory event ring at
+// a given rate, or attaches to a ring and unpacks from it, so the online
+// path can be tested and measured on one machine. See README.md.
+
+#include "analysis_pipeline/midas_event_unpacker/io/shm_event_ring.h"
+#include "analysis_pipeline/midas_event_unpacker/io/shm_event_source.h"
+#include "analysis_pipeline/midas_event_unpacker/stages/midas_event_to_byte_stream_stage.h"
+#include "analysis_pipeline/midas_event_unpacker/stages/midas_event_to_bank_view_stage.h"
+#include "midasio.h"
+#include <nlohmann/json.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Options {
+    bool consume = false;
+    std::string file;
+    std::string ring = "/midas_events";
+    uint32_t slots = 16;
+    uint64_t slotSize = 4 << 20;
+    double rate = 0.0;        // events/s, 0 = as fast as possible
+    double mbps = 0.0;        // MB/s, 0 = as fast as possible
+    int loops = 1;
+    bool preload = false;
+    bool keep = false;        // leave the ring name in place at the end
+    std::string stage = "bytestream";
+    uint32_t timeoutMs = 10000;
+};
+
+void usage() {
+    fprintf(stderr,
+        "Usage: midas_ring_replay --file RUN.mid[.lz4|.gz] [options]   (producer)\n"
+        "       midas_ring_replay --consume [options]                  (consumer)\n"
+        "  --ring NAME         shared-memory ring name (default /midas_events)\n"
+        "  --slots N           ring slots (default 16)\n"
+        "  --slot-size BYTES   bytes per slot, the largest event must fit (default 4194304)\n"
+        "  --rate EVENTS       events per second, 0 = unthrottled (default 0)\n"
+        "  --mbps MB           megabytes per second, 0 = unthrottled (default 0)\n"
+        "  --loop N            replay the file N times (default 1)\n"
+        "  --preload           read the file into memory first, so only the ring is measured\n"
+        "  --keep              do not remove the ring name when done\n"
+        "  --stage NAME        consumer: bytestream, bankview or none (default bytestream)\n"
+        "  --timeout MS        consumer: wait this long for the producer (default 10000)\n");
+}
+
+Options parseOptions(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) throw std::runtime_error("missing value for " + arg);
+            return argv[++i];
+        };
+        if (arg == "--consume") {
+            opt.consume = true;
+        } else if (arg == "--file") {
+            opt.file = value();
+        } else if (arg == "--ring") {
+            opt.ring = value();
+        } else if (arg == "--slots") {
+            opt.slots = std::stoul(value());
+        } else if (arg == "--slot-size") {
+            opt.slotSize = std::stoull(value());
+        } else if (arg == "--rate") {
+            opt.rate = std::stod(value());
+        } else if (arg == "--mbps") {
+            opt.mbps = std::stod(value());
+        } else if (arg == "--loop") {
+            opt.loops = std::max(1, std::stoi(value()));
+        } else if (arg == "--preload") {
+            opt.preload = true;
+        } else if (arg == "--keep") {
+            opt.keep = true;
+        } else if (arg == "--stage") {
+            opt.stage = value();
+            if (opt.stage != "bytestream" && opt.stage != "bankview" && opt.stage != "none") {
+                throw std::runtime_error("unknown stage '" + opt.stage + "'");
+            }
+        } else if (arg == "--timeout") {
+            opt.timeoutMs = std::stoul(value());
+        } else if (arg == "-h" || arg == "--help") {
+            usage();
+            exit(0);
+        } else {
+            throw std::runtime_error("unknown option " + arg);
+        }
+    }
+    if (!opt.consume && opt.file.empty()) {
+        throw std::runtime_error("--file is required in producer mode");
+    }
+    return opt;
+}
+
+void report(const char* what, uint64_t events, uint64_t bytes, double seconds) {
+    fprintf(stderr, "%s: %llu events, %.1f MB in %.3f s: %.0f events/s, %.1f MB/s\n", what,
+            static_cast<unsigned long long>(events), bytes / 1e6, seconds,
+            seconds > 0 ? events / seconds : 0.0, seconds > 0 ? bytes / seconds / 1e6 : 0.0);
+}
+
+// Holds the producer back to the requested event and byte rates. Before
+// sleeping it flushes the partly filled slot, so a slow stream still reaches
+// the consumer promptly.
+class Pacer {
+public:
+    Pacer(const Options& opt, ShmEventRingProducer& ring) : opt_(opt), ring_(ring), start_(Clock::now()) {}
+
+    void Wait(uint64_t events, uint64_t bytes) {
+        double due = 0.0;
+        if (opt_.rate > 0) due = std::max(due, events / opt_.rate);
+        if (opt_.mbps > 0) due = std::max(due, bytes / (opt_.mbps * 1e6));
+        auto target = start_ + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(due));
+        if (target > Clock::now()) {
+            ring_.Flush();
+            std::this_thread::sleep_until(target);
+        }
+    }
+
+private:
+    const Options& opt_;
+    ShmEventRingProducer& ring_;
+    Clock::time_point start_;
+};
+
+int produce(const Options& opt) {
+    ShmEventRingProducer ring(opt.ring, opt.slots, opt.slotSize);
+    const bool paced = opt.rate > 0 || opt.mbps > 0;
+
+    std::vector<char> preloaded;
+    if (opt.preload) {
+        std::unique_ptr<TMReaderInterface> reader(TMNewReader(opt.file.c_str()));
+        TMEvent event;
+        while (TMReadEvent(reader.get(), &event)) {
+            preloaded.insert(preloaded.end(), event.EventBytes(), event.EventBytes() + event.EventSize());
+        }
+        if (reader->fError) {
+            throw std::runtime_error("cannot read " + opt.file + ": " + reader->fErrorString);
+        }
+        reader->Close();
+    }
+
+    Pacer pacer(opt, ring);
+    uint64_t events = 0;
+    uint64_t bytes = 0;
+    auto start = Clock::now();
+
+    for (int loop = 0; loop < opt.loops; ++loop) {
+        if (opt.preload) {
+            size_t pos = 0;
+            while (pos + 16 <= preloaded.size()) {
+                uint32_t dataSize;
+                std::memcpy(&dataSize, preloaded.data() + pos + 12, 4);
+                size_t size = 16 + dataSize;
+                ring.Write(preloaded.data() + pos, size);
+                pos += size;
+                ++events;
+                bytes += size;
+                if (paced) pacer.Wait(events, bytes);
+            }
+            continue;
+        }
+
+        // the file is read straight into ring memory, the only copy on the way
+        std::unique_ptr<TMReaderInterface> reader(TMNewReader(opt.file.c_str()));
+        if (reader->fError) {
+            throw std::runtime_error("cannot read " + opt.file + ": " + reader->fErrorString);
+        }
+        char header[16];
+        while (reader->Read(header, sizeof(header)) == sizeof(header)) {
+            uint32_t dataSize;
+            std::memcpy(&dataSize, header + 12, 4);
+            size_t size = sizeof(header) + dataSize;
+            char* slot = ring.Reserve(size);
+            std::memcpy(slot, header, sizeof(header));
+            if (reader->Read(slot + sizeof(header), dataSize) != static_cast<int>(dataSize)) {
+                throw std::runtime_error("truncated event in " + opt.file);
+            }
+            ring.Commit(size);
+            ++events;
+            bytes += size;
+            if (paced) pacer.Wait(events, bytes);
+        }
+        reader->Close();
+    }
+
+    ring.Close(!opt.keep);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    report("produced", events, bytes, seconds);
+    fprintf(stderr, "producer waited %.3f s on a full ring\n", ring.ProducerStallNs() / 1e9);
+    return 0;
+}
+
+int consume(const Options& opt) {
+    ShmEventSource::Options sourceOptions;
+    sourceOptions.openTimeoutMs = opt.timeoutMs;
+    ShmEventSource source(opt.ring, sourceOptions);
+
+    PipelineDataProductManager manager;
+    std::unique_ptr<MidasEventUnpackerStage> stage;
+    if (opt.stage == "bytestream") {
+        stage = std::make_unique<MidasEventToByteStreamStage>();
+    } else if (opt.stage == "bankview") {
+        stage = std::make_unique<MidasEventToBankViewStage>();
+    }
+    if (stage) stage->Init(json::object(), &manager);
+
+    uint64_t events = 0;
+    uint64_t bytes = 0;
+    Clock::time_point start;
+    while (auto event = source.Next()) {
+        if (events == 0) start = Clock::now();  // do not count the wait for the producer
+        ++events;
+        bytes += event->EventSize();
+        if (stage) {
+            InputBundle input;
+            input.set("TMEvent", std::move(event));
+            stage->SetInput(input);
+            stage->Process();
+        }
+    }
+    double seconds = events ? std::chrono::duration<double>(Clock::now() - start).count() : 0.0;
+
+    if (source.HasError()) {
+        fprintf(stderr, "midas_ring_replay: %s\n", source.ErrorString().c_str());
+        return 1;
+    }
+    report("consumed", events, bytes, seconds);
+    fprintf(stderr, "consumer waited %.3f s on an empty ring, copied %llu events out of held slots\n",
+            source.GetStats().consumerStallNs / 1e9,
+            static_cast<unsigned long long>(source.GetStats().copiedEvents));
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    try {
+        Options opt = parseOptions(argc, argv);
+        return opt.consume ? consume(opt) : produce(opt);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "midas_ring_replay: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,413 @@
+// midas_unpacker_bench: throughput of the MIDAS reading and unpacking path
+// on synthetic runs. See "Benchmarks" in README.md.
+
+#include "synthetic_run.h"
+#include "analysis_pipeline/midas_event_unpacker/stages/midas_event_to_byte_stream_stage.h"
+#include "analysis_pipeline/midas_event_unpacker/stages/midas_event_to_json_stage.h"
+#include "midasio.h"
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using json = nlohmann::json;
+using midas_bench::BankFormat;
+using midas_bench::SyntheticRunConfig;
+
+namespace {
+
+struct Options {
+    SyntheticRunConfig run;
+    std::vector<BankFormat> formats = {BankFormat::kBkInit, BankFormat::kBkInit32, BankFormat::kBkInit32a};
+    std::vector<std::string> compressions = {"raw", "gz", "lz4"};
+    int repeat = 5;
+    int lz4Threads = 0;
+    std::string workdir = "/tmp";
+    std::string output;      // empty = stdout
+    std::string baseline;
+    double tolerance = 0.10;
+    bool keepFiles = false;
+};
+
+struct Result {
+    std::string phase;
+    std::string input;       // raw, gz, lz4, or memory
+    std::string bankFormat;
+    uint64_t events = 0;
+    uint64_t bytes = 0;
+    double seconds = 0.0;    // best of the repeats
+
+    std::string Name() const { return phase + "/" + input + "/" + bankFormat; }
+    double EventsPerSecond() const { return seconds > 0 ? events / seconds : 0.0; }
+    double MegabytesPerSecond() const { return seconds > 0 ? bytes / seconds / 1e6 : 0.0; }
+};
+
+void usage() {
+    fprintf(stderr,
+        "Usage: midas_unpacker_bench [options]\n"
+        "  --events N            events per run (default 20000)\n"
+        "  --event-size BYTES    bank payload per event (default 8192)\n"
+        "  --banks N             banks per event (default 8)\n"
+        "  --tids LIST           TID mix, e.g. UINT32,UINT16,FLOAT,DOUBLE,UINT8\n"
+        "  --formats LIST        bank header formats: bk_init,bk_init32,bk_init32a\n"
+        "  --compressions LIST   file formats to read: raw,gz,lz4\n"
+        "  --seed N              generator seed (default 12345)\n"
+        "  --repeat N            runs per measurement, the fastest is kept (default 5)\n"
+        "  --lz4-threads N       TMLz4ReaderThreads for .lz4 reading (default 0)\n"
+        "  --workdir DIR         where the run files go (default /tmp)\n"
+        "  --keep-files          do not delete the run files\n"
+        "  --output FILE         write the JSON results to FILE instead of stdout\n"
+        "  --baseline FILE       compare with results of an earlier run\n"
+        "  --tolerance X         allowed events/s drop against the baseline (default 0.10)\n");
+}
+
+std::vector<std::string> splitList(const std::string& s) {
+    std::vector<std::string> items;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+Options parseOptions(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) throw std::runtime_error("missing value for " + arg);
+            return argv[++i];
+        };
+        if (arg == "--events") {
+            opt.run.numEvents = std::stoul(value());
+        } else if (arg == "--event-size") {
+            opt.run.eventSize = std::stoul(value());
+        } else if (arg == "--banks") {
+            opt.run.banksPerEvent = std::stoul(value());
+        } else if (arg == "--tids") {
+            opt.run.tidMix.clear();
+            for (const auto& name : splitList(value())) opt.run.tidMix.push_back(midas_bench::ParseTid(name));
+        } else if (arg == "--formats") {
+            opt.formats.clear();
+            for (const auto& name : splitList(value())) {
+                BankFormat format;
+                if (!midas_bench::ParseBankFormat(name, &format)) {
+                    throw std::runtime_error("unknown bank format '" + name + "'");
+                }
+                opt.formats.push_back(format);
+            }
+        } else if (arg == "--compressions") {
+            opt.compressions = splitList(value());
+            for (const auto& c : opt.compressions) {
+                if (c != "raw" && c != "gz" && c != "lz4") throw std::runtime_error("unknown compression '" + c + "'");
+            }
+        } else if (arg == "--seed") {
+            opt.run.seed = std::stoull(value());
+        } else if (arg == "--repeat") {
+            opt.repeat = std::max(1, std::stoi(value()));
+        } else if (arg == "--lz4-threads") {
+            opt.lz4Threads = std::stoi(value());
+        } else if (arg == "--workdir") {
+            opt.workdir = value();
+        } else if (arg == "--keep-files") {
+            opt.keepFiles = true;
+        } else if (arg == "--output") {
+            opt.output = value();
+        } else if (arg == "--baseline") {
+            opt.baseline = value();
+        } else if (arg == "--tolerance") {
+            opt.tolerance = std::stod(value());
+        } else if (arg == "-h" || arg == "--help") {
+            usage();
+            exit(0);
+        } else {
+            throw std::runtime_error("unknown option " + arg);
+        }
+    }
+    return opt;
+}
+
+// Runs body repeat times and keeps the fastest; body returns events and bytes processed
+Result measure(const std::string& phase, const std::string& input, BankFormat format, int repeat,
+               const std::function<std::pair<uint64_t, uint64_t>()>& body) {
+    Result result;
+    result.phase = phase;
+    result.input = input;
+    result.bankFormat = midas_bench::BankFormatName(format);
+    for (int i = 0; i < repeat; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        auto counts = body();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (i == 0 || seconds < result.seconds) {
+            result.seconds = seconds;
+        }
+        result.events = counts.first;
+        result.bytes = counts.second;
+    }
+    fprintf(stderr, "%-40s %12.0f events/s %10.1f MB/s\n",
+            result.Name().c_str(), result.EventsPerSecond(), result.MegabytesPerSecond());
+    return result;
+}
+
+// Forget the bank scan, so every pass decodes the banks again
+void resetBankScan(TMEvent& event) {
+    event.banks.clear();
+    event.found_all_banks = false;
+    event.bank_scan_position = 0;
+    event.bank_index_valid = false;
+}
+
+std::pair<uint64_t, uint64_t> readFile(const std::string& filename) {
+    std::unique_ptr<TMReaderInterface> reader(TMNewReader(filename.c_str()));
+    if (reader->fError) {
+        throw std::runtime_error("cannot read " + filename + ": " + reader->fErrorString);
+    }
+    TMEvent event;
+    uint64_t events = 0;
+    uint64_t bytes = 0;
+    while (TMReadEvent(reader.get(), &event)) {
+        ++events;
+        bytes += event.EventSize();
+    }
+    reader->Close();
+    return {events, bytes};
+}
+
+std::pair<uint64_t, uint64_t> readFileMmap(const std::string& filename) {
+    TMMmapReader reader(filename.c_str());
+    uint64_t events = 0;
+    uint64_t bytes = 0;
+    while (auto event = reader.ReadEvent()) {
+        ++events;
+        bytes += event->EventSize();
+    }
+    if (reader.fError) {
+        throw std::runtime_error("cannot read " + filename + ": " + reader.fErrorString);
+    }
+    return {events, bytes};
+}
+
+std::vector<std::shared_ptr<TMEvent>> loadEvents(const std::string& filename, uint64_t* bytes) {
+    std::unique_ptr<TMReaderInterface> reader(TMNewReader(filename.c_str()));
+    std::vector<std::shared_ptr<TMEvent>> events;
+    *bytes = 0;
+    while (TMEvent* event = TMReadEvent(reader.get())) {
+        *bytes += event->EventSize();
+        events.emplace_back(event);
+    }
+    reader->Close();
+    return events;
+}
+
+template <typename Stage>
+std::pair<uint64_t, uint64_t> runStage(Stage& stage, const std::vector<std::shared_ptr<TMEvent>>& events,
+                                       uint64_t bytes) {
+    for (const auto& event : events) {
+        resetBankScan(*event);
+        InputBundle input;
+        input.set("TMEvent", event);
+        stage.SetInput(input);
+        stage.Process();
+    }
+    return {events.size(), bytes};
+}
+
+std::string runFileName(const Options& opt, BankFormat format, const std::string& compression) {
+    std::string name = opt.workdir + "/midas_bench_" + std::to_string(getpid()) + "_" +
+                       midas_bench::BankFormatName(format) + ".mid";
+    if (compression == "gz") return name + ".gz";
+    if (compression == "lz4") return name + ".lz4";
+    return name;
+}
+
+json configJson(const Options& opt) {
+    json tids = json::array();
+    for (int tid : opt.run.tidMix) tids.push_back(midas_bench::TidName(tid));
+    json formats = json::array();
+    for (BankFormat f : opt.formats) formats.push_back(midas_bench::BankFormatName(f));
+    return {
+        {"events", opt.run.numEvents},
+        {"event_size", opt.run.eventSize},
+        {"banks_per_event", opt.run.banksPerEvent},
+        {"tids", tids},
+        {"bank_formats", formats},
+        {"compressions", opt.compressions},
+        {"seed", opt.run.seed},
+        {"repeat", opt.repeat},
+        {"lz4_threads", opt.lz4Threads},
+    };
+}
+
+json resultJson(const Result& r) {
+    return {
+        {"name", r.Name()},
+        {"phase", r.phase},
+        {"input", r.input},
+        {"bank_format", r.bankFormat},
+        {"events", r.events},
+        {"bytes", r.bytes},
+        {"seconds", r.seconds},
+        {"events_per_s", r.EventsPerSecond()},
+        {"mb_per_s", r.MegabytesPerSecond()},
+    };
+}
+
+// Adds a "comparison" section; returns the number of regressions
+int compareWithBaseline(const std::string& filename, double tolerance, json& report) {
+    std::ifstream in(filename);
+    if (!in) {
+        throw std::runtime_error("cannot open baseline " + filename);
+    }
+    json baseline = json::parse(in);
+
+    // Rates are only comparable on the same synthetic run
+    const json baseConfig = baseline.value("config", json::object());
+    for (const char* key : {"events", "event_size", "banks_per_event", "tids", "seed"}) {
+        if (baseConfig.value(key, json()) != report["config"][key]) {
+            fprintf(stderr, "warning: baseline was measured with a different '%s'\n", key);
+        }
+    }
+
+    std::map<std::string, double> baseRates;
+    for (const auto& r : baseline.at("results")) {
+        baseRates[r.at("name").get<std::string>()] = r.at("events_per_s").get<double>();
+    }
+
+    int regressions = 0;
+    json comparison = json::array();
+    fprintf(stderr, "\n%-40s %10s %10s\n", "comparison with baseline", "ratio", "status");
+    for (const auto& r : report["results"]) {
+        const std::string name = r["name"];
+        auto it = baseRates.find(name);
+        if (it == baseRates.end() || it->second <= 0) {
+            continue;
+        }
+        double ratio = r["events_per_s"].get<double>() / it->second;
+        std::string status = "ok";
+        if (ratio < 1.0 - tolerance) {
+            status = "regression";
+            ++regressions;
+        } else if (ratio > 1.0 + tolerance) {
+            status = "improvement";
+        }
+        fprintf(stderr, "%-40s %10.3f %10s\n", name.c_str(), ratio, status.c_str());
+        comparison.push_back({{"name", name}, {"baseline_events_per_s", it->second}, {"ratio", ratio}, {"status", status}});
+    }
+
+    report["comparison"] = {{"baseline", filename}, {"tolerance", tolerance}, {"regressions", regressions},
+                            {"results", comparison}};
+    return regressions;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    try {
+        opt = parseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "midas_unpacker_bench: %s\n", e.what());
+        usage();
+        return 1;
+    }
+
+    spdlog::set_level(spdlog::level::warn);
+    TMLz4ReaderThreads = opt.lz4Threads;
+
+    json report;
+    report["benchmark"] = "midas_unpacker_bench";
+    report["format_version"] = 1;
+    report["config"] = configJson(opt);
+    report["results"] = json::array();
+
+    try {
+        for (BankFormat format : opt.formats) {
+            SyntheticRunConfig run = opt.run;
+            run.bankFormat = format;
+
+            std::vector<std::string> files;
+            for (const auto& compression : opt.compressions) {
+                files.push_back(runFileName(opt, format, compression));
+                midas_bench::WriteSyntheticRun(run, files.back());
+            }
+
+            // --- reading ---
+            for (size_t i = 0; i < files.size(); ++i) {
+                const std::string& file = files[i];
+                report["results"].push_back(resultJson(
+                    measure("read", opt.compressions[i], format, opt.repeat, [&] { return readFile(file); })));
+                if (opt.compressions[i] == "raw") {
+                    report["results"].push_back(resultJson(
+                        measure("read_mmap", "raw", format, opt.repeat, [&] { return readFileMmap(file); })));
+                }
+            }
+
+            // --- in-memory phases, on events loaded once ---
+            uint64_t bytes = 0;
+            auto events = loadEvents(files.front(), &bytes);
+
+            report["results"].push_back(resultJson(measure("find_all_banks", "memory", format, opt.repeat, [&] {
+                for (const auto& event : events) {
+                    resetBankScan(*event);
+                    event->FindAllBanks();
+                }
+                return std::make_pair<uint64_t, uint64_t>(events.size(), uint64_t(bytes));
+            })));
+
+            PipelineDataProductManager manager;
+
+            MidasEventToByteStreamStage byteStreamStage;
+            byteStreamStage.Init(json::object(), &manager);
+            report["results"].push_back(resultJson(measure("bytestream_stage", "memory", format, opt.repeat, [&] {
+                return runStage(byteStreamStage, events, bytes);
+            })));
+
+            MidasEventToJsonStage jsonStage;
+            jsonStage.Init(json::object(), &manager);
+            report["results"].push_back(resultJson(measure("json_stage", "memory", format, opt.repeat, [&] {
+                return runStage(jsonStage, events, bytes);
+            })));
+
+            if (!opt.keepFiles) {
+                for (const auto& file : files) unlink(file.c_str());
+            }
+        }
+    } catch (const std::exception& e) {
+        fprintf(stderr, "midas_unpacker_bench: %s\n", e.what());
+        return 1;
+    }
+
+    int regressions = 0;
+    if (!opt.baseline.empty()) {
+        try {
+            regressions = compareWithBaseline(opt.baseline, opt.tolerance, report);
+        } catch (const std::exception& e) {
+            fprintf(stderr, "midas_unpacker_bench: %s\n", e.what());
+            return 1;
+        }
+    }
+
+    if (opt.output.empty()) {
+        std::cout << report.dump(2) << std::endl;
+    } else {
+        std::ofstream out(opt.output);
+        out << report.dump(2) << std::endl;
+    }
+
+    if (regressions > 0) {
+        fprintf(stderr, "midas_unpacker_bench: %d regression(s) beyond %.0f%%\n", regressions, opt.tolerance * 100);
+        return 2;
+    }
+    return 0;
+}
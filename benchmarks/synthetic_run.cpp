@@ -0,0 +1,240 @@
+#include "synthetic_run.h"
+#include <zlib.h>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+namespace midas_bench {
+
+namespace {
+
+struct TidEntry {
+    int tid;
+    const char* name;
+    size_t elementSize;
+};
+
+const TidEntry kTids[] = {
+    {TID_UINT8, "UINT8", 1},   {TID_INT8, "INT8", 1},
+    {TID_UINT16, "UINT16", 2}, {TID_INT16, "INT16", 2},
+    {TID_UINT32, "UINT32", 4}, {TID_INT32, "INT32", 4},
+    {TID_UINT64, "UINT64", 8}, {TID_INT64, "INT64", 8},
+    {TID_FLOAT, "FLOAT", 4},   {TID_DOUBLE, "DOUBLE", 8},
+    {TID_STRING, "STRING", 1},
+};
+
+const TidEntry& tidEntry(int tid) {
+    for (const auto& entry : kTids) {
+        if (entry.tid == tid) return entry;
+    }
+    throw std::runtime_error("synthetic run: unsupported TID " + std::to_string(tid));
+}
+
+uint32_t bankHeaderFlags(BankFormat format) {
+    switch (format) {
+        case BankFormat::kBkInit:    return 0x01;
+        case BankFormat::kBkInit32:  return 0x11;
+        case BankFormat::kBkInit32a: return 0x31;
+    }
+    return 0x31;
+}
+
+template <typename T>
+void fillValues(std::vector<char>& buf, size_t count, std::mt19937_64& rng) {
+    for (size_t i = 0; i < count; ++i) {
+        T value;
+        if constexpr (std::is_floating_point_v<T>) {
+            // detector-like values, finite so every serializer takes its number path
+            value = static_cast<T>(std::uniform_real_distribution<double>(-1000.0, 1000.0)(rng));
+        } else {
+            // mostly small ADC/TDC-like counts with an occasional large one
+            uint64_t raw = rng();
+            value = static_cast<T>((raw & 0xF) == 0 ? raw >> 4 : raw & 0xFFF);
+        }
+        std::memcpy(buf.data() + i * sizeof(T), &value, sizeof(T));
+    }
+}
+
+void fillBank(int tid, std::vector<char>& buf, std::mt19937_64& rng) {
+    const size_t n = buf.size() / tidEntry(tid).elementSize;
+    switch (tid) {
+        case TID_UINT8:  fillValues<uint8_t>(buf, n, rng); break;
+        case TID_INT8:   fillValues<int8_t>(buf, n, rng); break;
+        case TID_UINT16: fillValues<uint16_t>(buf, n, rng); break;
+        case TID_INT16:  fillValues<int16_t>(buf, n, rng); break;
+        case TID_UINT32: fillValues<uint32_t>(buf, n, rng); break;
+        case TID_INT32:  fillValues<int32_t>(buf, n, rng); break;
+        case TID_UINT64: fillValues<uint64_t>(buf, n, rng); break;
+        case TID_INT64:  fillValues<int64_t>(buf, n, rng); break;
+        case TID_FLOAT:  fillValues<float>(buf, n, rng); break;
+        case TID_DOUBLE: fillValues<double>(buf, n, rng); break;
+        case TID_STRING:
+            for (auto& c : buf) c = static_cast<char>('a' + rng() % 26);
+            break;
+    }
+}
+
+size_t align8(size_t size) {
+    return (size + 7) & ~size_t(7);
+}
+
+void putU16(std::vector<char>& buf, uint16_t v) {
+    buf.insert(buf.end(), reinterpret_cast<const char*>(&v), reinterpret_cast<const char*>(&v) + 2);
+}
+
+void putU32(std::vector<char>& buf, uint32_t v) {
+    buf.insert(buf.end(), reinterpret_cast<const char*>(&v), reinterpret_cast<const char*>(&v) + 4);
+}
+
+// Same banks as event, with bk_init or bk_init32 bank headers
+std::vector<char> reencode(TMEvent& event, BankFormat format) {
+    event.FindAllBanks();
+    const TMEvent& constEvent = event;
+
+    std::vector<char> banks;
+    for (const auto& bank : event.banks) {
+        banks.insert(banks.end(), bank.name.begin(), bank.name.end());
+        if (format == BankFormat::kBkInit) {
+            if (bank.type > 0xFFFF || bank.data_size > 0xFFFF) {
+                throw std::runtime_error("synthetic run: bank " + bank.name + " of " +
+                                         std::to_string(bank.data_size) + " bytes does not fit bk_init");
+            }
+            putU16(banks, static_cast<uint16_t>(bank.type));
+            putU16(banks, static_cast<uint16_t>(bank.data_size));
+        } else {
+            putU32(banks, bank.type);
+            putU32(banks, bank.data_size);
+        }
+        const char* data = constEvent.GetBankData(&bank);
+        banks.insert(banks.end(), data, data + bank.data_size);
+        banks.resize(banks.size() + align8(bank.data_size) - bank.data_size, 0);
+    }
+
+    std::vector<char> bytes;
+    putU16(bytes, event.event_id);
+    putU16(bytes, event.trigger_mask);
+    putU32(bytes, event.serial_number);
+    putU32(bytes, event.time_stamp);
+    putU32(bytes, static_cast<uint32_t>(banks.size() + 8));
+    putU32(bytes, static_cast<uint32_t>(banks.size()));
+    putU32(bytes, bankHeaderFlags(format));
+    bytes.insert(bytes.end(), banks.begin(), banks.end());
+    return bytes;
+}
+
+class GzipWriter : public TMWriterInterface {
+public:
+    explicit GzipWriter(const std::string& filename) {
+        fGzFile = gzopen(filename.c_str(), "wb1");
+        if (!fGzFile) {
+            throw std::runtime_error("gzopen(\"" + filename + "\") failed");
+        }
+    }
+    ~GzipWriter() override { Close(); }
+
+    int Write(const void* buf, int count) override {
+        return gzwrite(fGzFile, buf, count);
+    }
+
+    int Close() override {
+        if (fGzFile) {
+            gzclose(fGzFile);
+            fGzFile = NULL;
+        }
+        return 0;
+    }
+
+private:
+    gzFile fGzFile = NULL;
+};
+
+bool hasSuffix(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+} // namespace
+
+const char* BankFormatName(BankFormat format) {
+    switch (format) {
+        case BankFormat::kBkInit:    return "bk_init";
+        case BankFormat::kBkInit32:  return "bk_init32";
+        case BankFormat::kBkInit32a: return "bk_init32a";
+    }
+    return "unknown";
+}
+
+bool ParseBankFormat(const std::string& name, BankFormat* format) {
+    for (BankFormat f : {BankFormat::kBkInit, BankFormat::kBkInit32, BankFormat::kBkInit32a}) {
+        if (name == BankFormatName(f)) {
+            *format = f;
+            return true;
+        }
+    }
+    return false;
+}
+
+int ParseTid(const std::string& name) {
+    for (const auto& entry : kTids) {
+        if (name == entry.name) return entry.tid;
+    }
+    throw std::runtime_error("unknown TID name '" + name + "'");
+}
+
+const char* TidName(int tid) {
+    return tidEntry(tid).name;
+}
+
+void MakeSyntheticEvent(const SyntheticRunConfig& config, uint32_t serial, std::mt19937_64& rng, TMEvent* event) {
+    if (config.banksPerEvent == 0 || config.tidMix.empty()) {
+        throw std::runtime_error("synthetic run: need at least one bank and one TID");
+    }
+
+    // a few event IDs and trigger bits, as from several front ends
+    const uint16_t eventId = 1 + serial % 4;
+    const uint16_t triggerMask = 1u << (serial % 4);
+    const uint32_t timeStamp = 1700000000 + serial / 1000;
+    event->Init(eventId, triggerMask, serial, timeStamp, config.eventSize + 32 * config.banksPerEvent);
+
+    const size_t bankBytes = config.eventSize / config.banksPerEvent;
+    std::vector<char> buf;
+    for (uint32_t i = 0; i < config.banksPerEvent; ++i) {
+        const int tid = config.tidMix[i % config.tidMix.size()];
+        const size_t elementSize = tidEntry(tid).elementSize;
+        buf.assign(bankBytes / elementSize * elementSize, 0);
+        fillBank(tid, buf, rng);
+
+        char name[5];
+        snprintf(name, sizeof(name), "B%03u", i % 1000);
+        event->AddBank(name, tid, buf.data(), buf.size());
+    }
+
+    if (config.bankFormat != BankFormat::kBkInit32a) {
+        std::vector<char> bytes = reencode(*event, config.bankFormat);
+        *event = TMEvent(bytes.data(), bytes.size());
+    }
+}
+
+TMWriterInterface* NewBenchWriter(const std::string& filename) {
+    if (hasSuffix(filename, ".gz")) {
+        return new GzipWriter(filename);
+    }
+    // TMNewWriter writes .lz4 as one frame of independent 4 MiB blocks with a content checksum
+    return TMNewWriter(filename.c_str());
+}
+
+uint64_t WriteSyntheticRun(const SyntheticRunConfig& config, const std::string& filename) {
+    std::unique_ptr<TMWriterInterface> writer(NewBenchWriter(filename));
+    std::mt19937_64 rng(config.seed);
+    TMEvent event;
+    uint64_t bytes = 0;
+    for (uint32_t serial = 0; serial < config.numEvents; ++serial) {
+        MakeSyntheticEvent(config, serial, rng, &event);
+        TMWriteEvent(writer.get(), &event);
+        bytes += event.EventSize();
+    }
+    writer->Close();
+    return bytes;
+}
+
+} // namespace midas_bench
@@ -0,0 +1,48 @@
+#ifndef MIDAS_EVENT_UNPACKER_SYNTHETIC_RUN_H
+#define MIDAS_EVENT_UNPACKER_SYNTHETIC_RUN_H
+
+#include "midasio.h"
+#include <cstdint>
+#include <random>
+#include <type_traits>
+#include <string>
+#include <vector>
+
+/**
+ * Reproducible synthetic MIDAS runs for the benchmarks. The same config and
+ * seed always give the same events, so numbers from different builds are
+ * measured on identical input.
+ */
+namespace midas_bench {
+
+enum class BankFormat { kBkInit, kBkInit32, kBkInit32a };
+
+struct SyntheticRunConfig {
+    uint32_t numEvents = 20000;
+    uint32_t eventSize = 8192;      // bank payload bytes per event, split evenly over the banks
+    uint32_t banksPerEvent = 8;
+    std::vector<int> tidMix = {TID_UINT32, TID_UINT16, TID_FLOAT, TID_DOUBLE, TID_UINT8};  // bank i has tidMix[i % size]
+    BankFormat bankFormat = BankFormat::kBkInit32a;
+    uint64_t seed = 12345;
+};
+
+const char* BankFormatName(BankFormat format);
+bool ParseBankFormat(const std::string& name, BankFormat* format);
+
+// Throws std::runtime_error for "UINT32"-style names that are not TID types
+int ParseTid(const std::string& name);
+const char* TidName(int tid);
+
+// Event serial of the run, built with TMEvent::Init/AddBank and re-encoded
+// for bk_init and bk_init32
+void MakeSyntheticEvent(const SyntheticRunConfig& config, uint32_t serial, std::mt19937_64& rng, TMEvent* event);
+
+// Writer for filename: ".gz" is gzip, ".lz4" an LZ4 frame, anything else raw
+TMWriterInterface* NewBenchWriter(const std::string& filename);
+
+// Writes the whole run with TMWriteEvent, returns the uncompressed event bytes
+uint64_t WriteSyntheticRun(const SyntheticRunConfig& config, const std::string& filename);
+
+} // namespace midas_bench
+
+#endif // MIDAS_EVENT_UNPACKER_SYNTHETIC_RUN_H
@@ -17,6 +17,14 @@
 bool TMWriterInterface::fgTrace = false;
 bool TMReaderInterface::fgTrace = false;
 
+TMWriterInterface::TMWriterInterface() // ctor
+{
+   if (TMWriterInterface::fgTrace)
+      printf("TMWriterInterface::ctor!\n");
+   fError = false;
+   fErrorString = "";
+}
+
 TMReaderInterface::TMReaderInterface() // ctor
 {
    if (TMReaderInterface::fgTrace)
@@ -407,34 +415,946 @@ public:
    char* fSrcBuf;
 };
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <algorithm> // std::min()
+#include "mlz4.h"
+#include "mlz4hc.h"
+#include "mxxhash.h"
+
+int TMLz4ReaderThreads = 0;
+
+static uint32_t Lz4ReadLE32(const void* p)
+{
+   uint32_t v;
+   memcpy(&v, p, 4);
+   return v;
+}
+
+// LZ4 frame descriptor, see the LZ4 frame format description
+
+struct Lz4FrameHeader
+{
+   bool     block_independent = false;
+   bool     block_checksum    = false;
+   bool     content_checksum  = false;
+   bool     dict_id           = false;
+   size_t   block_max_size    = 0;
+   std::string bytes;                 ///< the raw header bytes as read from the file
+};
+
+// Read one LZ4 frame header, skipping skippable frames.
+// Returns 1 on success, 0 on clean end of file, -1 on error.
+
+static int Lz4ReadFrameHeader(TMReaderInterface* reader, Lz4FrameHeader* h, std::string* error)
+{
+   while (1) {
+      char magic[4];
+      int rd = reader->Read(magic, 4);
+      if (rd == 0)
+         return 0;
+      if (rd != 4) {
+         *error = "truncated LZ4 frame magic";
+         return -1;
+      }
+
+      uint32_t m = Lz4ReadLE32(magic);
+
+      if ((m & 0xFFFFFFF0) == 0x184D2A50) { // skippable frame
+         char sz[4];
+         if (reader->Read(sz, 4) != 4) {
+            *error = "truncated LZ4 skippable frame";
+            return -1;
+         }
+         // the size comes from the file, skip in chunks instead of allocating it
+         uint32_t remaining = Lz4ReadLE32(sz);
+         char skip[16*1024];
+         while (remaining > 0) {
+            int n = std::min(remaining, (uint32_t)sizeof(skip));
+            if (reader->Read(skip, n) != n) {
+               *error = "truncated LZ4 skippable frame";
+               return -1;
+            }
+            remaining -= n;
+         }
+         continue;
+      }
+
+      if (m != 0x184D2204) {
+         *error = "invalid LZ4 frame magic " + to_string(m);
+         return -1;
+      }
+
+      unsigned char desc[2+8+4+1];
+      if (reader->Read(desc, 2) != 2) {
+         *error = "truncated LZ4 frame header";
+         return -1;
+      }
+
+      unsigned flg = desc[0];
+      unsigned bd  = desc[1];
+
+      if ((flg >> 6) != 1) {
+         *error = "unsupported LZ4 frame version " + to_string(flg >> 6);
+         return -1;
+      }
+
+      h->block_independent = flg & 0x20;
+      h->block_checksum    = flg & 0x10;
+      h->content_checksum  = flg & 0x04;
+      h->dict_id           = flg & 0x01;
+
+      unsigned bsid = (bd >> 4) & 7;
+      if (bsid < 4) {
+         *error = "invalid LZ4 block size id " + to_string(bsid);
+         return -1;
+      }
+      h->block_max_size = 1 << (8 + 2*bsid);
+
+      size_t more = ((flg & 0x08) ? 8 : 0) + (h->dict_id ? 4 : 0) + 1;
+      if (reader->Read(desc+2, more) != (int)more) {
+         *error = "truncated LZ4 frame header";
+         return -1;
+      }
+
+      unsigned hc = (XXH32(desc, 2+more-1, 0) >> 8) & 0xFF;
+      if (hc != desc[2+more-1]) {
+         *error = "LZ4 frame header checksum mismatch";
+         return -1;
+      }
+
+      h->bytes.assign(magic, 4);
+      h->bytes.append((const char*)desc, 2+more);
+      return 1;
+   }
+}
+
+// Replays bytes already consumed from a reader, then continues reading from it
+
+class PrefixReader: public TMReaderInterface
+{
+ public:
+   PrefixReader(const std::string& prefix, TMReaderInterface* reader)
+   {
+      fPrefix = prefix;
+      fPos = 0;
+      fReader = reader;
+      fError = reader->fError;
+      fErrorString = reader->fErrorString;
+   }
+
+   ~PrefixReader() // dtor
+   {
+      if (fReader) {
+         delete fReader;
+         fReader = NULL;
+      }
+   }
+
+   int Read(void* buf, int count)
+   {
+      int n = 0;
+      if (fPos < fPrefix.size()) {
+         n = std::min((size_t)count, fPrefix.size() - fPos);
+         memcpy(buf, fPrefix.data() + fPos, n);
+         fPos += n;
+         if (n == count)
+            return n;
+      }
+      int rd = fReader->Read((char*)buf + n, count - n);
+      if (rd < 0) {
+         fError = fReader->fError;
+         fErrorString = fReader->fErrorString;
+         return n > 0 ? n : rd;
+      }
+      return n + rd;
+   }
+
+   int Close()
+   {
+      return fReader->Close();
+   }
+
+   std::string fPrefix;
+   size_t fPos;
+   TMReaderInterface* fReader;
+};
+
+// Decompresses LZ4 frames with independent blocks on a pool of worker threads.
+//
+// A dispatcher thread reads compressed blocks from the underlying reader into
+// a ring of slots, workers decompress the slots in any order, and Read() hands
+// out the decompressed data in file order. Frames with linked blocks depend on
+// previously decompressed data and are handled by the serial Lz4Reader instead,
+// see TMNewLz4Reader().
+
+class Lz4ParallelReader: public TMReaderInterface
+{
+ public:
+   enum SlotState { kFree, kQueued, kDone };
+   enum SlotType { kData, kFrameEnd, kStreamEnd, kError };
+
+   struct Slot
+   {
+      SlotState state = kFree;
+      SlotType type = kData;
+      bool uncompressed = false;
+      bool verify_checksum = false;
+      uint32_t checksum = 0;       ///< block checksum for kData, content checksum for kFrameEnd
+      bool has_checksum = false;
+      bool content_checksum = false; ///< the frame this block belongs to has a content checksum
+      size_t max_size = 0;         ///< block maximum size of the frame this block belongs to
+      std::vector<char> src;
+      std::vector<char> dst;
+      size_t dst_size = 0;
+      std::string error;
+   };
+
+   Lz4ParallelReader(TMReaderInterface* reader, const Lz4FrameHeader& header, int num_threads, int num_buffers)
+   {
+      if (TMReaderInterface::fgTrace)
+         printf("Lz4ParallelReader::ctor!\n");
+
+      fReader = reader;
+      fFirstHeader = header;
+
+      if (num_buffers < 2*num_threads)
+         num_buffers = 2*num_threads;
+      fSlots.resize(num_buffers);
+
+      XXH32_reset(&fContentHash, 0);
+
+      fDispatcher = std::thread(&Lz4ParallelReader::Dispatch, this);
+      for (int i=0; i<num_threads; i++)
+         fWorkers.push_back(std::thread(&Lz4ParallelReader::Work, this));
+   }
+
+   ~Lz4ParallelReader() // dtor
+   {
+      if (TMReaderInterface::fgTrace)
+         printf("Lz4ParallelReader::dtor!\n");
+
+      Stop();
+
+      if (fReader) {
+         delete fReader;
+         fReader = NULL;
+      }
+   }
+
+   void Stop()
+   {
+      {
+         std::lock_guard<std::mutex> lock(fMutex);
+         fStop = true;
+      }
+      fFreeCv.notify_all();
+      fWorkCv.notify_all();
+      fDoneCv.notify_all();
+      if (fDispatcher.joinable())
+         fDispatcher.join();
+      for (size_t i=0; i<fWorkers.size(); i++)
+         if (fWorkers[i].joinable())
+            fWorkers[i].join();
+      fWorkers.clear();
+   }
+
+   int Read(void* buf, int count)
+   {
+      if (fError)
+         return -1;
+
+      char* cptr = (char*)buf;
+      int clen = 0;
+
+      while (clen < count) {
+         Slot& slot = fSlots[fConsumeSeq % fSlots.size()];
+
+         if (!fHaveSlot) {
+            std::unique_lock<std::mutex> lock(fMutex);
+            fDoneCv.wait(lock, [&]{ return slot.state == kDone || fStop; });
+            if (slot.state != kDone)
+               return clen;
+            lock.unlock();
+
+            fHaveSlot = true;
+            fSlotPos = 0;
+
+            if (slot.type == kStreamEnd) {
+               fHaveSlot = false; // leave the slot in place, every further Read() returns end of file
+               return clen;
+            } else if (slot.type == kError) {
+               fHaveSlot = false;
+               fError = true;
+               fErrorString = slot.error;
+               return clen > 0 ? clen : -1;
+            } else if (slot.type == kFrameEnd) {
+               if (slot.has_checksum && XXH32_digest(&fContentHash) != slot.checksum) {
+                  fError = true;
+                  fErrorString = "Lz4ParallelReader: content checksum mismatch";
+                  return clen > 0 ? clen : -1;
+               }
+               XXH32_reset(&fContentHash, 0);
+               ReleaseSlot();
+               continue;
+            } else {
+               if (slot.content_checksum)
+                  XXH32_update(&fContentHash, slot.dst.data(), slot.dst_size);
+            }
+         }
+
+         size_t n = std::min((size_t)(count - clen), slot.dst_size - fSlotPos);
+         memcpy(cptr, slot.dst.data() + fSlotPos, n);
+         cptr += n;
+         clen += n;
+         fSlotPos += n;
+
+         if (fSlotPos == slot.dst_size)
+            ReleaseSlot();
+      }
+
+      return clen;
+   }
+
+   int Close()
+   {
+      if (TMReaderInterface::fgTrace)
+         printf("Lz4ParallelReader::Close!\n");
+      Stop();
+      return fReader->Close();
+   }
+
+ private:
+   void ReleaseSlot()
+   {
+      Slot& slot = fSlots[fConsumeSeq % fSlots.size()];
+      {
+         std::lock_guard<std::mutex> lock(fMutex);
+         slot.state = kFree;
+      }
+      fFreeCv.notify_one();
+      fHaveSlot = false;
+      fConsumeSeq++;
+   }
+
+   // Runs on the dispatcher thread: reads blocks and queues them in file order.
+   // Each slot carries the parameters of its own frame, Read() may still be
+   // working on an earlier frame of a concatenated file.
+
+   void Dispatch()
+   {
+      Lz4FrameHeader header = fFirstHeader;
+      bool in_frame = true; // the first frame header was read by TMNewLz4Reader()
+
+      while (1) {
+         Slot& slot = fSlots[fDispatchSeq % fSlots.size()];
+         {
+            std::unique_lock<std::mutex> lock(fMutex);
+            fFreeCv.wait(lock, [&]{ return slot.state == kFree || fStop; });
+            if (fStop)
+               return;
+         }
+
+         slot.error.clear();
+         slot.has_checksum = false;
+         slot.content_checksum = header.content_checksum;
+
+         bool last = false;
+
+         if (!in_frame) {
+            Lz4FrameHeader h;
+            std::string error;
+            int status = Lz4ReadFrameHeader(fReader, &h, &error);
+            if (status == 0) {
+               slot.type = kStreamEnd;
+               last = true;
+            } else if (status < 0) {
+               slot.type = kError;
+               slot.error = "Lz4ParallelReader: " + error;
+               last = true;
+            } else if (!h.block_independent || h.dict_id) {
+               slot.type = kError;
+               slot.error = "Lz4ParallelReader: frame with linked blocks or dictionary after the first frame, use the serial reader for this file";
+               last = true;
+            } else {
+               header = h;
+               in_frame = true;
+               continue;
+            }
+         } else {
+            char bsize[4];
+            int rd = fReader->Read(bsize, 4);
+            uint32_t bs = Lz4ReadLE32(bsize);
+            if (rd != 4) {
+               slot.type = kError;
+               slot.error = "Lz4ParallelReader: truncated LZ4 block header";
+               last = true;
+            } else if (bs == 0) { // end mark
+               slot.type = kFrameEnd;
+               in_frame = false;
+               if (header.content_checksum) {
+                  char cs[4];
+                  if (fReader->Read(cs, 4) != 4) {
+                     slot.type = kError;
+                     slot.error = "Lz4ParallelReader: truncated LZ4 content checksum";
+                     last = true;
+                  } else {
+                     slot.has_checksum = true;
+                     slot.checksum = Lz4ReadLE32(cs);
+                  }
+               }
+            } else {
+               slot.type = kData;
+               slot.max_size = header.block_max_size;
+               slot.uncompressed = bs & 0x80000000;
+               size_t size = bs & 0x7FFFFFFF;
+               if (size > header.block_max_size) {
+                  slot.type = kError;
+                  slot.error = "Lz4ParallelReader: LZ4 block size " + to_string(size) + " is bigger than the frame maximum";
+                  last = true;
+               } else {
+                  slot.src.resize(size);
+                  rd = fReader->Read(slot.src.data(), size);
+                  if (rd != (int)size) {
+                     slot.type = kError;
+                     slot.error = "Lz4ParallelReader: truncated LZ4 block";
+                     last = true;
+                  } else if (header.block_checksum) {
+                     char cs[4];
+                     if (fReader->Read(cs, 4) != 4) {
+                        slot.type = kError;
+                        slot.error = "Lz4ParallelReader: truncated LZ4 block checksum";
+                        last = true;
+                     } else {
+                        slot.has_checksum = true;
+                        slot.checksum = Lz4ReadLE32(cs);
+                     }
+                  }
+               }
+            }
+         }
+
+         {
+            std::lock_guard<std::mutex> lock(fMutex);
+            if (slot.type == kData) {
+               slot.state = kQueued;
+               fWork.push_back(&slot);
+            } else {
+               slot.state = kDone;
+            }
+         }
+
+         if (slot.type == kData) {
+            fWorkCv.notify_one();
+         } else {
+            fDoneCv.notify_all();
+         }
+
+         fDispatchSeq++;
+
+         if (last)
+            return;
+      }
+   }
+
+   // Runs on the worker threads: decompresses queued blocks
+
+   void Work()
+   {
+      while (1) {
+         Slot* slot = NULL;
+         {
+            std::unique_lock<std::mutex> lock(fMutex);
+            fWorkCv.wait(lock, [&]{ return !fWork.empty() || fStop; });
+            if (fStop)
+               return;
+            slot = fWork.front();
+            fWork.pop_front();
+         }
+
+         if (slot->has_checksum && XXH32(slot->src.data(), slot->src.size(), 0) != slot->checksum) {
+            slot->type = kError;
+            slot->error = "Lz4ParallelReader: LZ4 block checksum mismatch";
+         } else if (slot->uncompressed) {
+            slot->dst.swap(slot->src);
+            slot->dst_size = slot->dst.size();
+         } else {
+            if (slot->dst.size() < slot->max_size)
+               slot->dst.resize(slot->max_size);
+            int n = MLZ4_decompress_safe(slot->src.data(), slot->dst.data(), slot->src.size(), slot->dst.size());
+            if (n < 0) {
+               slot->type = kError;
+               slot->error = "Lz4ParallelReader: MLZ4_decompress_safe() error " + to_string(n);
+            } else {
+               slot->dst_size = n;
+            }
+         }
+
+         {
+            std::lock_guard<std::mutex> lock(fMutex);
+            slot->state = kDone;
+         }
+         fDoneCv.notify_all();
+      }
+   }
+
+   TMReaderInterface* fReader = NULL;
+   Lz4FrameHeader fFirstHeader;     ///< read by TMNewLz4Reader(), the dispatcher thread keeps its own copy
+   XXH32_state_t fContentHash;
+
+   std::vector<Slot> fSlots;
+   std::deque<Slot*> fWork;
+   size_t fDispatchSeq = 0;  ///< next slot the dispatcher fills
+   size_t fConsumeSeq = 0;   ///< next slot Read() takes data from
+   bool   fHaveSlot = false; ///< Read() is part way through slot fConsumeSeq
+   size_t fSlotPos = 0;
+
+   std::mutex fMutex;
+   std::condition_variable fFreeCv;
+   std::condition_variable fWorkCv;
+   std::condition_variable fDoneCv;
+   bool fStop = false;
+
+   std::thread fDispatcher;
+   std::vector<std::thread> fWorkers;
+};
+
+TMReaderInterface* TMNewLz4Reader(TMReaderInterface* reader, int num_threads, int num_buffers)
+{
+   if (num_threads <= 1 || reader->fError)
+      return new Lz4Reader(reader);
+
+   Lz4FrameHeader h;
+   std::string error;
+   int status = Lz4ReadFrameHeader(reader, &h, &error);
+
+   if (status < 0) {
+      ErrorReader* e = new ErrorReader("");
+      e->fErrorString = "TMNewLz4Reader: " + error;
+      delete reader;
+      return e;
+   }
+
+   if (status == 0 || !h.block_independent || h.dict_id) {
+      // linked blocks or empty file: use the serial reader
+      if (TMReaderInterface::fgTrace)
+         printf("TMNewLz4Reader: using serial reader\n");
+      return new Lz4Reader(new PrefixReader(h.bytes, reader));
+   }
+
+   return new Lz4ParallelReader(reader, h, num_threads, num_buffers);
+}
+
 class FileWriter: public TMWriterInterface
 {
  public:
    FileWriter(const char* filename)
    {
+      if (TMWriterInterface::fgTrace)
+         printf("FileWriter::ctor!\n");
       fFilename = filename;
       fFp = fopen(filename, "w");
-      assert(fFp != NULL); // FIXME: check for error
+      if (!fFp) {
+         fError = true;
+         fErrorString = Errno((std::string("fopen(\"")+filename+"\")").c_str());
+      }
+   }
+
+   ~FileWriter() // dtor
+   {
+      if (TMWriterInterface::fgTrace)
+         printf("FileWriter::dtor!\n");
+      if (fFp)
+         Close();
    }
 
    int Write(const void* buf, int count)
    {
+      if (fError)
+         return -1;
       assert(fFp != NULL);
-      return fwrite(buf, 1, count, fFp);
+      int wr = fwrite(buf, 1, count, fFp);
+      if (wr != count) {
+         fError = true;
+         fErrorString = Errno((std::string("fwrite(\"")+fFilename+"\")").c_str());
+      }
+      return wr;
    }
 
    int Close()
    {
-      assert(fFp != NULL);
-      fclose(fFp);
-      fFp = NULL;
-      return 0;
+      if (TMWriterInterface::fgTrace)
+         printf("FileWriter::Close!\n");
+      if (fFp) {
+         if (fclose(fFp) != 0 && !fError) {
+            fError = true;
+            fErrorString = Errno((std::string("fclose(\"")+fFilename+"\")").c_str());
+         }
+         fFp = NULL;
+      }
+      return fError ? -1 : 0;
    }
 
    std::string fFilename;
    FILE* fFp;
 };
 
+int TMLz4WriterLevel = 1;
+int TMLz4WriterThreads = 0;
+
+// Writes one LZ4 frame with independent blocks, so the output can be read
+// by Lz4Reader and decompressed in parallel by Lz4ParallelReader.
+// With num_threads > 0 full blocks are compressed on worker threads and a
+// writer thread writes them out in order; Write() only copies data and
+// updates the content checksum. fError belongs to the thread calling Write()
+// and Close(): write errors of the writer thread are kept under fMutex and
+// copied into fError when that thread next takes a slot or closes.
+
+class Lz4Writer: public TMWriterInterface
+{
+ public:
+   enum SlotState { kFree, kQueued, kDone };
+
+   struct Slot
+   {
+      SlotState state = kFree;
+      std::vector<char> src;
+      size_t src_size = 0;
+      std::vector<char> dst;
+      size_t dst_size = 0;
+      bool uncompressed = false;
+   };
+
+   static const int kBlockSizeId = 7; // 4 MiB blocks
+   static const size_t kBlockSize = 4*1024*1024;
+
+   Lz4Writer(TMWriterInterface* writer, int level, bool content_checksum, int num_threads, int num_buffers)
+   {
+      if (TMWriterInterface::fgTrace)
+         printf("Lz4Writer::ctor!\n");
+
+      fWriter = writer;
+      fLevel = level;
+      fContentChecksum = content_checksum;
+
+      if (num_threads < 0)
+         num_threads = 0;
+      if (num_buffers < 2*num_threads)
+         num_buffers = 2*num_threads;
+      if (num_buffers < 1)
+         num_buffers = 1;
+      fSlots.resize(num_buffers);
+
+      XXH32_reset(&fContentHash, 0);
+
+      if (fWriter->fError) {
+         fError = true;
+         fErrorString = fWriter->fErrorString;
+         return;
+      }
+
+      // frame header: magic, FLG (version 01, independent blocks, content checksum), BD, HC
+      unsigned char header[7];
+      uint32_t magic = 0x184D2204;
+      memcpy(header, &magic, 4);
+      header[4] = 0x40 | 0x20 | (fContentChecksum ? 0x04 : 0);
+      header[5] = kBlockSizeId << 4;
+      header[6] = (XXH32(header+4, 2, 0) >> 8) & 0xFF;
+      WriteOut(header, sizeof(header));
+
+      if (num_threads > 0) {
+         fWriterThread = std::thread(&Lz4Writer::Drain, this);
+         for (int i=0; i<num_threads; i++)
+            fWorkers.push_back(std::thread(&Lz4Writer::Work, this));
+      }
+   }
+
+   ~Lz4Writer() // dtor
+   {
+      if (TMWriterInterface::fgTrace)
+         printf("Lz4Writer::dtor!\n");
+
+      if (fWriter)
+         Close();
+   }
+
+   int Write(const void* buf, int count)
+   {
+      if (!fWriter)
+         return -1;
+
+      if (fContentChecksum)
+         XXH32_update(&fContentHash, buf, count);
+
+      const char* cptr = (const char*)buf;
+      int clen = 0;
+
+      while (clen < count) {
+         Slot* slot = FillSlot();
+         if (!slot)
+            return -1;
+
+         size_t n = std::min((size_t)(count - clen), kBlockSize - slot->src_size);
+         memcpy(slot->src.data() + slot->src_size, cptr, n);
+         slot->src_size += n;
+         cptr += n;
+         clen += n;
+
+         if (slot->src_size == kBlockSize)
+            Submit();
+      }
+
+      return clen;
+   }
+
+   int Close()
+   {
+      if (TMWriterInterface::fgTrace)
+         printf("Lz4Writer::Close!\n");
+
+      if (!fWriter)
+         return fError ? -1 : 0;
+
+      if (fHaveSlot)
+         Submit();
+
+      if (fWriterThread.joinable()) {
+         {
+            std::unique_lock<std::mutex> lock(fMutex);
+            fDrainedCv.wait(lock, [&]{ return fWriteSeq == fFillSeq || fWriteFailed; });
+         }
+         Stop();
+      }
+
+      if (!UpdateError()) {
+         unsigned char trailer[8];
+         memset(trailer, 0, 4); // end mark
+         uint32_t checksum = XXH32_digest(&fContentHash);
+         memcpy(trailer+4, &checksum, 4);
+         WriteOut(trailer, fContentChecksum ? 8 : 4);
+      }
+
+      fWriter->Close();
+      UpdateError();
+      if (!fError && fWriter->fError) {
+         fError = true;
+         fErrorString = fWriter->fErrorString;
+      }
+      delete fWriter;
+      fWriter = NULL;
+
+      return fError ? -1 : 0;
+   }
+
+ private:
+   void Stop()
+   {
+      {
+         std::lock_guard<std::mutex> lock(fMutex);
+         fStop = true;
+      }
+      fFreeCv.notify_all();
+      fWorkCv.notify_all();
+      fDoneCv.notify_all();
+      if (fWriterThread.joinable())
+         fWriterThread.join();
+      for (size_t i=0; i<fWorkers.size(); i++)
+         if (fWorkers[i].joinable())
+            fWorkers[i].join();
+      fWorkers.clear();
+   }
+
+   // Slot Write() copies into, waits for the writer thread to free one if needed
+
+   Slot* FillSlot()
+   {
+      Slot& slot = fSlots[fFillSeq % fSlots.size()];
+      if (!fHaveSlot) {
+         if (fWriterThread.joinable()) {
+            std::unique_lock<std::mutex> lock(fMutex);
+            fFreeCv.wait(lock, [&]{ return slot.state == kFree || fWriteFailed; });
+            if (fWriteFailed) {
+               CopyWriteError();
+               return NULL;
+            }
+         } else if (UpdateError()) {
+            return NULL;
+         }
+         if (slot.src.size() < kBlockSize)
+            slot.src.resize(kBlockSize);
+         slot.src_size = 0;
+         fHaveSlot = true;
+      }
+      return &slot;
+   }
+
+   void Submit()
+   {
+      Slot& slot = fSlots[fFillSeq % fSlots.size()];
+      fHaveSlot = false;
+
+      if (!fWriterThread.joinable()) {
+         Compress(&slot);
+         WriteSlot(&slot);
+         fFillSeq++;
+         return;
+      }
+
+      {
+         std::lock_guard<std::mutex> lock(fMutex);
+         slot.state = kQueued;
+         fWork.push_back(&slot);
+         fFillSeq++;
+      }
+      fWorkCv.notify_one();
+   }
+
+   void Compress(Slot* slot)
+   {
+      int bound = MLZ4_compressBound(slot->src_size);
+      if (slot->dst.size() < (size_t)bound)
+         slot->dst.resize(bound);
+
+      int n;
+      if (fLevel >= 3)
+         n = MLZ4_compress_HC(slot->src.data(), slot->dst.data(), slot->src_size, bound, fLevel);
+      else
+         n = MLZ4_compress_fast(slot->src.data(), slot->dst.data(), slot->src_size, bound, fLevel < 0 ? -fLevel : 1);
+
+      // incompressible data is stored as is, flagged in the block size
+      slot->uncompressed = (n <= 0 || (size_t)n >= slot->src_size);
+      slot->dst_size = slot->uncompressed ? slot->src_size : n;
+   }
+
+   void WriteSlot(Slot* slot)
+   {
+      uint32_t bs = slot->dst_size | (slot->uncompressed ? 0x80000000 : 0);
+      WriteOut(&bs, 4);
+      WriteOut(slot->uncompressed ? slot->src.data() : slot->dst.data(), slot->dst_size);
+   }
+
+   // Called by the thread calling Write() and Close(), and by the writer
+   // thread while it runs; only one of them writes at a time
+
+   void WriteOut(const void* buf, size_t count)
+   {
+      {
+         std::lock_guard<std::mutex> lock(fMutex);
+         if (fWriteFailed)
+            return;
+      }
+      int wr = fWriter->Write(buf, count);
+      if (wr != (int)count) {
+         {
+            std::lock_guard<std::mutex> lock(fMutex);
+            fWriteFailed = true;
+            fWriteErrorString = "Lz4Writer: write error";
+            if (fWriter->fError)
+               fWriteErrorString += ": " + fWriter->fErrorString;
+         }
+         fFreeCv.notify_all();
+         fDrainedCv.notify_all();
+      }
+   }
+
+   // Copies a write error into fError, fMutex held
+
+   void CopyWriteError()
+   {
+      if (fWriteFailed && !fError) {
+         fError = true;
+         fErrorString = fWriteErrorString;
+      }
+   }
+
+   bool UpdateError()
+   {
+      std::lock_guard<std::mutex> lock(fMutex);
+      CopyWriteError();
+      return fError;
+   }
+
+   // Runs on the worker threads: compresses queued blocks
+
+   void Work()
+   {
+      while (1) {
+         Slot* slot = NULL;
+         {
+            std::unique_lock<std::mutex> lock(fMutex);
+            fWorkCv.wait(lock, [&]{ return !fWork.empty() || fStop; });
+            if (fStop)
+               return;
+            slot = fWork.front();
+            fWork.pop_front();
+         }
+
+         Compress(slot);
+
+         {
+            std::lock_guard<std::mutex> lock(fMutex);
+            slot->state = kDone;
+         }
+         fDoneCv.notify_all();
+      }
+   }
+
+   // Runs on the writer thread: writes compressed blocks in file order
+
+   void Drain()
+   {
+      while (1) {
+         Slot& slot = fSlots[fWriteSeq % fSlots.size()];
+         {
+            std::unique_lock<std::mutex> lock(fMutex);
+            fDoneCv.wait(lock, [&]{ return slot.state == kDone || fStop; });
+            if (slot.state != kDone)
+               return;
+         }
+
+         WriteSlot(&slot);
+
+         {
+            std::lock_guard<std::mutex> lock(fMutex);
+            slot.state = kFree;
+            fWriteSeq++;
+         }
+         fFreeCv.notify_one();
+         fDrainedCv.notify_all();
+      }
+   }
+
+   TMWriterInterface* fWriter = NULL;
+   int  fLevel = 1;
+   bool fContentChecksum = true;
+   XXH32_state_t fContentHash;
+
+   std::vector<Slot> fSlots;
+   std::deque<Slot*> fWork;
+   size_t fFillSeq = 0;       ///< next slot Write() fills
+   size_t fWriteSeq = 0;      ///< next slot the writer thread writes out
+   bool   fHaveSlot = false;  ///< Write() is part way through slot fFillSeq
+
+   std::mutex fMutex;
+   std::condition_variable fFreeCv;
+   std::condition_variable fWorkCv;
+   std::condition_variable fDoneCv;
+   std::condition_variable fDrainedCv;
+   bool fStop = false;
+   bool fWriteFailed = false;       ///< a WriteOut() failed, under fMutex
+   std::string fWriteErrorString;
+
+   std::thread fWriterThread;
+   std::vector<std::thread> fWorkers;
+};
+
+TMWriterInterface* TMNewLz4Writer(TMWriterInterface* writer, int level, bool content_checksum, int num_threads, int num_buffers)
+{
+   return new Lz4Writer(writer, level, content_checksum, num_threads, num_buffers);
+}
+
 static int hasSuffix(const char*name,const char*suffix)
 {
    const char* s = strstr(name,suffix);
@@ -532,7 +1452,7 @@ TMReaderInterface* TMNewReader(const char* source)
       }
    else if (hasSuffix(source, ".lz4"))
       {
-         return new Lz4Reader(new FileReader(source));
+         return TMNewLz4Reader(new FileReader(source), TMLz4ReaderThreads);
       }
    else
       {
@@ -540,6 +1460,11 @@ TMReaderInterface* TMNewReader(const char* source)
       }
 }
 
+TMWriterInterface* TMNewFileWriter(const char* filename)
+{
+   return new FileWriter(filename);
+}
+
 TMWriterInterface* TMNewWriter(const char* destination)
 {
    if (0) {
@@ -548,9 +1473,9 @@ TMWriterInterface* TMNewWriter(const char* destination)
       return new ZlibReader(source);
    } else if (hasSuffix(source, ".bz2")) {
       return new PipeReader((std::string("bzip2 -dc ") + source).c_str());
-   } else if (hasSuffix(source, ".lz4")) {
-      return new Lz4Reader(new FileReader(source));
 #endif
+   } else if (hasSuffix(destination, ".lz4")) {
+      return TMNewLz4Writer(new FileWriter(destination), TMLz4WriterLevel, true, TMLz4WriterThreads);
    } else {
       return new FileWriter(destination);
    }
@@ -582,7 +1507,7 @@ static size_t Align8(size_t size)
    return (size + 7) & ~7;
 }
 
-TMEvent* TMReadEvent(TMReaderInterface* reader)
+bool TMReadEvent(TMReaderInterface* reader, TMEvent* e)
 {
    bool gOnce = true;
    if (gOnce) {
@@ -592,8 +1517,6 @@ TMEvent* TMReadEvent(TMReaderInterface* reader)
       assert(sizeof(uint32_t)==4);
    }
    
-   TMEvent* e = new TMEvent;
-
    e->Reset();
 
    const int event_header_size = 4*4;
@@ -602,15 +1525,13 @@ TMEvent* TMReadEvent(TMReaderInterface* reader)
    int rd = reader->Read(event_header, event_header_size);
 
    if (rd < 0) { // read error
-      delete e;
-      return NULL;
+      return false;
    } else if (rd == 0) { // end of file
-      delete e;
-      return NULL;
+      return false;
    } else if (rd != event_header_size) { // truncated data in file
       fprintf(stderr, "TMReadEvent: error: read %d shorter than event header size %d\n", (int)rd, (int)event_header_size);
       e->error = true;
-      return e;
+      return true;
    }
 
    e->event_id      = GetU16(event_header+0);
@@ -637,20 +1558,336 @@ TMEvent* TMReadEvent(TMReaderInterface* reader)
    rd = reader->Read(&e->data[event_header_size], to_read);
 
    if (rd < 0) { // read error
-      delete e;
-      return NULL;
+      return false;
    } else if (rd != (int)to_read) { // truncated data in file
       fprintf(stderr, "TMReadEvent: error: short read %d instead of %d\n", (int)rd, (int)to_read);
       e->error = true;
+      return true;
+   }
+
+   return true;
+}
+
+TMEvent* TMReadEvent(TMReaderInterface* reader)
+{
+   TMEvent* e = new TMEvent;
+
+   if (!TMReadEvent(reader, e)) {
+      delete e;
+      return NULL;
+   }
+
+   return e;
+}
+
+#include <mutex>
+#include <new> // std::bad_alloc
+
+class TMEventPoolState
+{
+ public:
+   TMEventPoolState(size_t max_free_events) // ctor
+   {
+      fMaxFreeEvents = max_free_events;
+      fFreeEvents.reserve(max_free_events);
+   }
+
+   ~TMEventPoolState() // dtor
+   {
+      for (size_t i=0; i<fFreeEvents.size(); i++)
+         delete fFreeEvents[i];
+      fFreeEvents.clear();
+      while (fFreeBlocks) {
+         Block* b = fFreeBlocks;
+         fFreeBlocks = b->next;
+         free(b);
+      }
+   }
+
+   TMEvent* GetEvent()
+   {
+      {
+         std::lock_guard<std::mutex> lock(fMutex);
+         if (!fFreeEvents.empty()) {
+            TMEvent* e = fFreeEvents.back();
+            fFreeEvents.pop_back();
+            fStats.events_recycled++;
+            return e;
+         }
+         fStats.events_allocated++;
+      }
+      return new TMEvent;
+   }
+
+   void PutEvent(TMEvent* e)
+   {
+      // keep the capacity of data[] and banks[], drop everything else
+      e->Reset();
+      {
+         std::lock_guard<std::mutex> lock(fMutex);
+         if (fFreeEvents.size() < fMaxFreeEvents) {
+            fFreeEvents.push_back(e);
+            fStats.events_returned++;
+            return;
+         }
+         fStats.events_deleted++;
+      }
+      delete e;
+   }
+
+   // shared_ptr control blocks all have the same size, recycle them through a free list
+
+   void* GetBlock(size_t size)
+   {
+      if (size <= kBlockSize) {
+         std::lock_guard<std::mutex> lock(fMutex);
+         if (fFreeBlocks) {
+            Block* b = fFreeBlocks;
+            fFreeBlocks = b->next;
+            return b;
+         }
+         fStats.blocks_allocated++;
+      }
+      void* p = malloc(size < kBlockSize ? kBlockSize : size);
+      if (!p)
+         throw std::bad_alloc();
+      return p;
+   }
+
+   void PutBlock(void* p, size_t size)
+   {
+      if (size <= kBlockSize) {
+         std::lock_guard<std::mutex> lock(fMutex);
+         Block* b = (Block*)p;
+         b->next = fFreeBlocks;
+         fFreeBlocks = b;
+         return;
+      }
+      free(p);
+   }
+
+   struct Block { Block* next; };
+   static constexpr size_t kBlockSize = 128; // larger than any shared_ptr control block with a small deleter
+
+   mutable std::mutex fMutex;
+   size_t fMaxFreeEvents = 0;
+   std::vector<TMEvent*> fFreeEvents;
+   Block* fFreeBlocks = NULL;
+   TMEventPool::Stats fStats;
+};
+
+template <typename T>
+struct TMEventPoolAllocator
+{
+   typedef T value_type;
+
+   TMEventPoolAllocator(const std::shared_ptr<TMEventPoolState>& state) : fState(state) {}
+   template <typename U> TMEventPoolAllocator(const TMEventPoolAllocator<U>& a) : fState(a.fState) {}
+
+   T* allocate(size_t n) { return (T*)fState->GetBlock(n*sizeof(T)); }
+   void deallocate(T* p, size_t n) { fState->PutBlock(p, n*sizeof(T)); }
+
+   template <typename U> bool operator==(const TMEventPoolAllocator<U>& a) const { return fState == a.fState; }
+   template <typename U> bool operator!=(const TMEventPoolAllocator<U>& a) const { return fState != a.fState; }
+
+   std::shared_ptr<TMEventPoolState> fState;
+};
+
+struct TMEventPoolDeleter
+{
+   void operator()(TMEvent* e) const { fState->PutEvent(e); }
+
+   std::shared_ptr<TMEventPoolState> fState;
+};
+
+TMEventPool::TMEventPool(size_t max_free_events) // ctor
+{
+   fState = std::make_shared<TMEventPoolState>(max_free_events);
+}
+
+TMEventPool::~TMEventPool() // dtor
+{
+   // events still in use hold their own reference to fState
+   // and are deleted when they are released
+}
+
+std::shared_ptr<TMEvent> TMEventPool::NewEvent()
+{
+   TMEvent* e = fState->GetEvent();
+   return std::shared_ptr<TMEvent>(e, TMEventPoolDeleter{fState}, TMEventPoolAllocator<TMEvent>(fState));
+}
+
+std::shared_ptr<TMEvent> TMEventPool::ReadEvent(TMReaderInterface* reader)
+{
+   std::shared_ptr<TMEvent> e = NewEvent();
+
+   size_t capacity = e->data.capacity();
+
+   if (!TMReadEvent(reader, e.get()))
+      return NULL;
+
+   if (e->data.capacity() != capacity) {
+      std::lock_guard<std::mutex> lock(fState->fMutex);
+      fState->fStats.buffer_grows++;
+   }
+
+   return e;
+}
+
+TMEventPool::Stats TMEventPool::GetStats() const
+{
+   std::lock_guard<std::mutex> lock(fState->fMutex);
+   Stats s = fState->fStats;
+   s.events_free = fState->fFreeEvents.size();
+   return s;
+}
+
+#include <fcntl.h>    // open()
+#include <unistd.h>   // close()
+#include <sys/stat.h> // fstat()
+#include <sys/mman.h> // mmap()
+
+class TMMappedFile
+{
+ public:
+   TMMappedFile(void* addr, size_t size) // ctor
+   {
+      fAddr = addr;
+      fSize = size;
+   }
+
+   ~TMMappedFile() // dtor
+   {
+      if (TMReaderInterface::fgTrace)
+         printf("TMMappedFile::dtor!\n");
+      if (fAddr)
+         munmap(fAddr, fSize);
+      fAddr = NULL;
+   }
+
+   void* fAddr;
+   size_t fSize;
+};
+
+bool TMCanMmap(const char* source)
+{
+   if (strstr(source, "://"))
+      return false;
+   if (hasSuffix(source, ".gz") || hasSuffix(source, ".bz2") || hasSuffix(source, ".lz4"))
+      return false;
+
+   struct stat st;
+   if (stat(source, &st) != 0)
+      return false;
+
+   return S_ISREG(st.st_mode);
+}
+
+TMMmapReader::TMMmapReader(const char* filename) // ctor
+{
+   if (TMReaderInterface::fgTrace)
+      printf("TMMmapReader::ctor!\n");
+
+   fError = false;
+   fFilename = filename;
+   fPosition = 0;
+
+   int fd = open(filename, O_RDONLY);
+   if (fd < 0) {
+      fError = true;
+      fErrorString = Errno((std::string("open(\"")+filename+"\")").c_str());
+      return;
+   }
+
+   struct stat st;
+   if (fstat(fd, &st) != 0) {
+      fError = true;
+      fErrorString = Errno((std::string("fstat(\"")+filename+"\")").c_str());
+      close(fd);
+      return;
+   }
+
+   size_t size = st.st_size;
+
+   if (size == 0) {
+      // empty file, nothing to map, ReadEvent() returns end of file
+      close(fd);
+      return;
+   }
+
+   void* addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd); // the mapping stays valid after the file is closed
+
+   if (addr == MAP_FAILED) {
+      fError = true;
+      fErrorString = Errno((std::string("mmap(\"")+filename+"\")").c_str());
+      return;
+   }
+
+   madvise(addr, size, MADV_SEQUENTIAL);
+
+   fFile = std::make_shared<TMMappedFile>(addr, size);
+}
+
+TMMmapReader::~TMMmapReader() // dtor
+{
+   if (TMReaderInterface::fgTrace)
+      printf("TMMmapReader::dtor!\n");
+   Close();
+}
+
+int TMMmapReader::Close()
+{
+   // events still in use keep their own reference to the mapping
+   fFile.reset();
+   return 0;
+}
+
+std::shared_ptr<TMEvent> TMMmapReader::ReadEvent()
+{
+   if (fError)
+      return NULL;
+
+   if (!fFile) // empty or closed file
+      return NULL;
+
+   const char* base = (const char*)fFile->fAddr;
+   size_t size = fFile->fSize;
+
+   if (fPosition >= size) // end of file
+      return NULL;
+
+   const size_t event_header_size = 4*4;
+   size_t remaining = size - fPosition;
+
+   std::shared_ptr<TMEvent> e = std::make_shared<TMEvent>();
+
+   if (remaining < event_header_size) { // truncated data in file
+      fprintf(stderr, "TMMmapReader::ReadEvent: error: read %d shorter than event header size %d\n", (int)remaining, (int)event_header_size);
+      fPosition = size;
+      e->error = true;
+      return e;
+   }
+
+   size_t event_size = event_header_size + GetU32(base + fPosition + 12);
+
+   if (event_size > remaining) { // truncated data in file
+      fprintf(stderr, "TMMmapReader::ReadEvent: error: short read %d instead of %d\n", (int)(remaining - event_header_size), (int)(event_size - event_header_size));
+      fPosition = size;
+      e->error = true;
       return e;
    }
 
+   e->InitView(base + fPosition, event_size, fFile);
+
+   fPosition += event_size;
+
    return e;
 }
 
 void TMWriteEvent(TMWriterInterface* writer, const TMEvent* event)
 {
-   writer->Write(&(event->data[0]), event->data.size());
+   writer->Write(event->EventBytes(), event->EventSize());
 }
 
 std::string TMEvent::HeaderToString() const
@@ -703,6 +1940,47 @@ void TMEvent::Reset()
 
    found_all_banks = false;
    bank_scan_position = 0;
+
+   bank_index_valid = false;
+   bank_records.clear();
+   bank_hash.clear();
+
+   view_data = NULL;
+   view_size = 0;
+   view_owner.reset();
+}
+
+void TMEvent::InitView(const void* buf, size_t buf_size, std::shared_ptr<const void> owner)
+{
+   Reset();
+   ParseHeader(buf, buf_size);
+
+   if (error) {
+      return;
+   }
+
+   size_t zevent_size = event_header_size + data_size;
+
+   if (zevent_size > buf_size) {
+      fprintf(stderr, "TMEvent::InitView: error: buffer size %d is smaller than event size %d\n", (int)buf_size, (int)zevent_size);
+      error = true;
+      return;
+   }
+
+   view_data  = (const char*)buf;
+   view_size  = zevent_size;
+   view_owner = std::move(owner);
+}
+
+void TMEvent::MakeWritable()
+{
+   if (!view_data)
+      return;
+   // bank offsets are relative to the event start, so banks[] and the bank index stay valid
+   data.assign(view_data, view_data + view_size);
+   view_data = NULL;
+   view_size = 0;
+   view_owner.reset();
 }
 
 void TMEvent::ParseEvent()
@@ -824,6 +2102,7 @@ void TMEvent::Init(uint16_t xevent_id, uint16_t xtrigger_mask, uint32_t xserial_
 
 void TMEvent::AddBank(const char* bank_name, int tid, const char* buf, size_t size)
 {
+   MakeWritable();
    assert(data.size() > 0); // must call Init() before calling AddBank()
 
    size_t bank_size = event_header_size + Align8(size);
@@ -856,6 +2135,8 @@ void TMEvent::AddBank(const char* bank_name, int tid, const char* buf, size_t si
 
    // add a bank record
 
+   bank_index_valid = false; // rebuilt on next lookup
+
    if (found_all_banks) {
       TMBank b;
       b.name = bank_name;
@@ -872,15 +2153,18 @@ static size_t FindFirstBank(TMEvent* e)
       return 0;
    
    size_t off = e->event_header_size;
+
+   const char* p = e->EventBytes();
+   size_t size = e->EventSize();
    
-   if (e->data.size() < off + 8) {
-      fprintf(stderr, "TMEvent::FindFirstBank: error: data size %d is too small\n", (int)e->data.size());
+   if (size < off + 8) {
+      fprintf(stderr, "TMEvent::FindFirstBank: error: data size %d is too small\n", (int)size);
       e->error = true;
       return 0;
    }
 
-   uint32_t bank_header_data_size = GetU32(&e->data[off]);
-   uint32_t bank_header_flags     = GetU32(&e->data[off+4]);
+   uint32_t bank_header_data_size = GetU32(p+off);
+   uint32_t bank_header_flags     = GetU32(p+off+4);
 
    //printf("bank header: data size %d, flags 0x%08x\n", bank_header_data_size, bank_header_flags);
 
@@ -908,12 +2192,35 @@ static char xchar(char c)
 }
 #endif
 
+static size_t DecodeBankHeader(uint32_t bank_header_flags, const char* pbank, uint32_t* type, uint32_t* data_size)
+{
+   if (bank_header_flags & (1<<5)) {
+      // bk_init32a format
+      *type      = GetU32(pbank+4+0);
+      *data_size = GetU32(pbank+4+4);
+      return 4+4+4+4;
+   } else if (bank_header_flags & (1<<4)) {
+      // bk_init32 format
+      *type      = GetU32(pbank+4+0);
+      *data_size = GetU32(pbank+4+4);
+      return 4+4+4;
+   } else {
+      // bk_init format
+      *type      = GetU16(pbank+4+0);
+      *data_size = GetU16(pbank+4+2);
+      return 4+2+2;
+   }
+}
+
 static size_t FindNextBank(TMEvent* e, size_t pos, TMBank** pb)
 {
    if (e->error)
       return 0;
 
-   size_t remaining = e->data.size() - pos;
+   const char* p = e->EventBytes();
+   size_t size = e->EventSize();
+
+   size_t remaining = size - pos;
 
    //printf("pos %d, event data_size %d, size %d, remaining %d\n", pos, e->data_size, (int)e->data.size(), remaining);
 
@@ -935,33 +2242,11 @@ static size_t FindNextBank(TMEvent* e, size_t pos, TMBank** pb)
 
    TMBank* b = &e->banks[ibank];
 
-   b->name.resize(4);
-   b->name[0] = e->data[pos+0];
-   b->name[1] = e->data[pos+1];
-   b->name[2] = e->data[pos+2];
-   b->name[3] = e->data[pos+3];
-   b->name[4] = 0;
-
-   size_t data_offset = 0;
+   b->name.assign(p+pos, 4);
 
    //printf("bank header flags: 0x%08x\n", e->bank_header_flags);
 
-   if (e->bank_header_flags & (1<<5)) {
-      // bk_init32a format
-      b->type      = GetU32(&e->data[pos+4+0]);
-      b->data_size = GetU32(&e->data[pos+4+4]);
-      data_offset = pos+4+4+4+4;
-   } else if (e->bank_header_flags & (1<<4)) {
-      // bk_init32 format
-      b->type      = GetU32(&e->data[pos+4+0]);
-      b->data_size = GetU32(&e->data[pos+4+4]);
-      data_offset = pos+4+4+4;
-   } else {
-      // bk_init format
-      b->type      = GetU16(&e->data[pos+4+0]);
-      b->data_size = GetU16(&e->data[pos+4+2]);
-      data_offset = pos+4+2+2;
-   }
+   size_t data_offset = pos + DecodeBankHeader(e->bank_header_flags, p+pos, &b->type, &b->data_size);
 
    b->data_offset = data_offset;
 
@@ -981,8 +2266,8 @@ static size_t FindNextBank(TMEvent* e, size_t pos, TMBank** pb)
 
    //printf("pos %d, next bank at %d: [%c%c%c%c]\n", pos, npos, xchar(e->data[npos+0]), xchar(e->data[npos+1]), xchar(e->data[npos+2]), xchar(e->data[npos+3]));
 
-   if (npos > e->data.size()) {
-      fprintf(stderr, "TMEvent::FindNextBank: error: invalid bank data size %d: aligned %d, npos %d, end of event %d\n", b->data_size, (int)aligned_data_size, (int)npos, (int)e->data.size());
+   if (npos > size) {
+      fprintf(stderr, "TMEvent::FindNextBank: error: invalid bank data size %d: aligned %d, npos %d, end of event %d\n", b->data_size, (int)aligned_data_size, (int)npos, (int)size);
       e->error = true;
       return 0;
    }
@@ -997,6 +2282,7 @@ char* TMEvent::GetEventData()
 {
    if (error)
       return NULL;
+   MakeWritable(); // views are read-only, modify a private copy
    if (event_header_size == 0)
       return NULL;
    if (event_header_size > data.size())
@@ -1012,11 +2298,11 @@ const char* TMEvent::GetEventData() const
       return NULL;
    if (event_header_size == 0)
       return NULL;
-   if (event_header_size > data.size())
+   if (event_header_size > EventSize())
       return NULL;
-   if (event_header_size + data_size > data.size())
+   if (event_header_size + data_size > EventSize())
       return NULL;
-   return &data[event_header_size];
+   return EventBytes() + event_header_size;
 }
 
 char* TMEvent::GetBankData(const TMBank* b)
@@ -1025,6 +2311,7 @@ char* TMEvent::GetBankData(const TMBank* b)
       return NULL;
    if (!b)
       return NULL;
+   MakeWritable(); // views are read-only, modify a private copy
    if (b->data_offset >= data.size())
       return NULL;
    if (b->data_offset + b->data_size > data.size())
@@ -1038,11 +2325,11 @@ const char* TMEvent::GetBankData(const TMBank* b) const
       return NULL;
    if (!b)
       return NULL;
-   if (b->data_offset >= data.size())
+   if (b->data_offset >= EventSize())
       return NULL;
-   if (b->data_offset + b->data_size > data.size())
+   if (b->data_offset + b->data_size > EventSize())
       return NULL;
-   return &data[b->data_offset];
+   return EventBytes() + b->data_offset;
 }
 
 TMBank* TMEvent::FindBank(const char* bank_name)
@@ -1086,6 +2373,108 @@ TMBank* TMEvent::FindBank(const char* bank_name)
    return NULL;
 }
 
+static uint32_t HashFourCC(uint32_t fourcc)
+{
+   uint32_t h = fourcc * 0x9E3779B1;
+   return h ^ (h >> 16);
+}
+
+void TMEvent::BuildBankIndex()
+{
+   bank_index_valid = true;
+   bank_records.clear();
+   bank_hash.clear();
+
+   size_t pos = FindFirstBank(this);
+
+   const char* p = EventBytes();
+   size_t size = EventSize();
+
+   while (pos > 0 && pos < size) {
+      if (size - pos < 8) {
+         fprintf(stderr, "TMEvent::BuildBankIndex: error: too few bytes %d remaining at the end of event\n", (int)(size - pos));
+         error = true;
+         break;
+      }
+
+      TMBankRecord r;
+      r.fourcc = GetU32(p+pos);
+      size_t data_offset = pos + DecodeBankHeader(bank_header_flags, p+pos, &r.type, &r.data_size);
+      r.data_offset = data_offset;
+
+      if (r.type < 1 || r.type >= TID_LAST) {
+         fprintf(stderr, "TMEvent::BuildBankIndex: error: invalid tid %d\n", r.type);
+         error = true;
+         break;
+      }
+
+      size_t npos = data_offset + Align8(r.data_size);
+
+      if (npos > size) {
+         fprintf(stderr, "TMEvent::BuildBankIndex: error: invalid bank data size %d, npos %d, end of event %d\n", r.data_size, (int)npos, (int)size);
+         error = true;
+         break;
+      }
+
+      bank_records.push_back(r);
+      pos = npos;
+   }
+
+   // hash table at most half full, so probe sequences stay short
+
+   size_t nbanks = bank_records.size();
+   size_t capacity = 16;
+   while (capacity < 2*nbanks)
+      capacity <<= 1;
+
+   bank_hash.assign(capacity, -1);
+
+   uint32_t mask = capacity - 1;
+   for (size_t i=0; i<nbanks; i++) {
+      uint32_t fourcc = bank_records[i].fourcc;
+      uint32_t h = HashFourCC(fourcc) & mask;
+      while (bank_hash[h] >= 0) {
+         if (bank_records[bank_hash[h]].fourcc == fourcc)
+            break; // duplicate bank name, keep the first one, same as FindBank(const char*)
+         h = (h + 1) & mask;
+      }
+      if (bank_hash[h] < 0)
+         bank_hash[h] = i;
+   }
+}
+
+const TMBankRecord* TMEvent::FindBankRecord(uint32_t fourcc)
+{
+   if (!bank_index_valid)
+      BuildBankIndex();
+
+   if (error)
+      return NULL;
+
+   uint32_t mask = bank_hash.size() - 1;
+   uint32_t h = HashFourCC(fourcc) & mask;
+
+   while (bank_hash[h] >= 0) {
+      const TMBankRecord* r = &bank_records[bank_hash[h]];
+      if (r->fourcc == fourcc)
+         return r;
+      h = (h + 1) & mask;
+   }
+
+   return NULL;
+}
+
+const char* TMEvent::GetBankData(const TMBankRecord* r) const
+{
+   if (error)
+      return NULL;
+   if (!r)
+      return NULL;
+   if ((size_t)r->data_offset + r->data_size > EventSize())
+      return NULL;
+   return EventBytes() + r->data_offset;
+}
+
 void TMEvent::FindAllBanks()
 {
    if (found_all_banks)
@@ -1104,7 +2493,7 @@ void TMEvent::PrintHeader() const
           serial_number,
           time_stamp,
           data_size,
-          (int)data.size(),
+          (int)EventSize(),
           (int)data.capacity()
           );
 }
@@ -1127,7 +2516,7 @@ void TMEvent::PrintBanks(int level)
                 banks[i].type,
                 banks[i].data_size);
          if (level > 1) {
-            const char* p = GetBankData(&banks[i]);
+            const char* p = ((const TMEvent*)this)->GetBankData(&banks[i]);
             if (p) {
                for (size_t j=0; j<banks[i].data_size; j+=4) {
                   printf("%11d: 0x%08x\n", (int)j, *(uint32_t*)(p+j));
@@ -1140,13 +2529,13 @@ void TMEvent::PrintBanks(int level)
 
 void TMEvent::DumpHeader() const
 {
-   const char* p = data.data();
+   const char* p = EventBytes();
 
    // event header
    printf(" 0: 0x%08x\n", GetU32(p+0*4));
    printf(" 1: 0x%08x\n", GetU32(p+1*4));
    printf(" 2: 0x%08x\n", GetU32(p+2*4));
-   printf(" 3: 0x%08x (0x%08x and 0x%08x-0x10)\n", GetU32(p+3*4), data_size, (int)data.size());
+   printf(" 3: 0x%08x (0x%08x and 0x%08x-0x10)\n", GetU32(p+3*4), data_size, (int)EventSize());
 
    // bank header
    printf(" 4: 0x%08x\n", GetU32(p+4*4));
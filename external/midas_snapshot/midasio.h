@@ -5,7 +5,9 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 #include <stdint.h>
+#include <string.h> // memcpy()
 
 #ifndef TID_LAST
 /**
@@ -49,6 +51,24 @@ class TMBank
    size_t      data_offset = 0; ///< offset of data for this bank in the event data[] container
 };
 
+struct TMBankRecord
+{
+   uint32_t fourcc;             ///< bank name packed as FOURCC, same byte order as in the event data
+   uint32_t type;               ///< type of bank data, enum of TID_xxx
+   uint32_t data_size;          ///< size of bank data in bytes
+   uint32_t data_offset;        ///< offset of data for this bank in the MIDAS event bytes
+};
+
+inline uint32_t TMFourCC(const char* bank_name) ///< pack a bank name as FOURCC, short names are padded with zeros
+{
+   char c[4] = { 0, 0, 0, 0 };
+   for (int i=0; i<4 && bank_name[i]; i++)
+      c[i] = bank_name[i];
+   uint32_t v;
+   memcpy(&v, c, 4);
+   return v;
+}
+
 class TMEvent
 {
 public: // event data
@@ -71,6 +91,18 @@ public: // internal data
    bool found_all_banks;        ///< all the banks in the event data have been discovered
    size_t bank_scan_position;   ///< location where scan for MIDAS banks was last stopped
 
+public: // compact bank index, fill using BuildBankIndex()
+
+   bool bank_index_valid;                  ///< bank_records and bank_hash describe the current event data
+   std::vector<TMBankRecord> bank_records; ///< all banks in event order
+   std::vector<int32_t> bank_hash;         ///< open-addressed table of indices into bank_records, -1 is empty, size is a power of 2
+
+public: // zero-copy view data
+
+   const char* view_data;       ///< MIDAS event bytes owned by someone else, data[] is empty if this is set
+   size_t view_size;            ///< size of the MIDAS event bytes at view_data
+   std::shared_ptr<const void> view_owner; ///< keeps the memory at view_data alive
+
 public: // constructors
    TMEvent(); // ctor
    TMEvent(const void* buf, size_t buf_size); // ctor
@@ -78,14 +110,22 @@ public: // constructors
    void ParseEvent();  ///< parse event data
    void ParseHeader(const void* buf, size_t buf_size); ///< parse event header
    void Init(uint16_t event_id, uint16_t trigger_mask = 0, uint32_t serial_number = 0, uint32_t time_stamp = 0, size_t capacity = 0);
+   void InitView(const void* buf, size_t buf_size, std::shared_ptr<const void> owner); ///< make this event a read-only view of buf, no copy
+   bool IsView() const { return view_data != NULL; } ///< event bytes are not in data[]
+   void MakeWritable(); ///< copy the bytes of a view into data[] and drop the view, no-op for other events
+   const char* EventBytes() const { return view_data ? view_data : data.data(); } ///< MIDAS event bytes, header included
+   size_t EventSize() const { return view_data ? view_size : data.size(); }      ///< size of the MIDAS event bytes
 
 public: // read data
    void FindAllBanks();                      ///< scan the MIDAS event, find all data banks
    TMBank* FindBank(const char* bank_name);  ///< scan the MIDAS event
-   char* GetEventData();                     ///< get pointer to MIDAS event data
+   void BuildBankIndex();                    ///< scan all bank headers once, fill bank_records and bank_hash, banks[] is not touched
+   const TMBankRecord* FindBankRecord(uint32_t fourcc); ///< find bank using the bank index, build it if needed, no allocation once capacity is there
+   char* GetEventData();                     ///< get pointer to MIDAS event data, copies a view into data[] first
    const char* GetEventData() const;         ///< get pointer to MIDAS event data
-   char* GetBankData(const TMBank*);         ///< get pointer to MIDAS data bank
+   char* GetBankData(const TMBank*);         ///< get pointer to MIDAS data bank, copies a view into data[] first
    const char* GetBankData(const TMBank*) const; ///< get pointer to MIDAS data bank
+   const char* GetBankData(const TMBankRecord*) const; ///< get pointer to MIDAS data bank
 
 public: // add data
    void AddBank(const char* bank_name, int tid, const char* buf, size_t size); ///< add new MIDAS bank
@@ -120,17 +160,74 @@ class TMReaderInterface
 class TMWriterInterface
 {
  public:
+   TMWriterInterface(); // ctor
    virtual int Write(const void* buf, int count) = 0;
    virtual int Close() = 0;
    virtual ~TMWriterInterface() {};
  public:
+   bool fError;
+   std::string fErrorString;
    static bool fgTrace;
 };
 
 TMReaderInterface* TMNewReader(const char* source);
+TMReaderInterface* TMNewLz4Reader(TMReaderInterface* reader, int num_threads, int num_buffers = 0); ///< LZ4 decompression of reader, num_threads > 1 decompresses independent-block frames in parallel
+extern int TMLz4ReaderThreads; ///< decompression threads TMNewReader() uses for .lz4 files, 0 or 1 is the serial reader
 TMWriterInterface* TMNewWriter(const char* destination);
+TMWriterInterface* TMNewFileWriter(const char* filename); ///< plain file, whatever the suffix
+TMWriterInterface* TMNewLz4Writer(TMWriterInterface* writer, int level, bool content_checksum, int num_threads, int num_buffers = 0); ///< LZ4 frame compression into writer, level 1-2 fast, 3-12 HC, negative is faster than 1; num_threads > 0 compresses blocks on a thread pool
+extern int TMLz4WriterLevel;   ///< compression level TMNewWriter() uses for .lz4 files
+extern int TMLz4WriterThreads; ///< compression threads TMNewWriter() uses for .lz4 files, 0 compresses in Write()
+
+class TMMappedFile; // memory mapping of a whole file, shared by all events read from it
+
+class TMMmapReader
+{
+ public:
+   TMMmapReader(const char* filename); // ctor
+   ~TMMmapReader(); // dtor
+   std::shared_ptr<TMEvent> ReadEvent(); ///< next event as a read-only view into the mapped file, NULL at end of file or on read error
+   int Close();
+ public:
+   bool fError;
+   std::string fErrorString;
+   std::string fFilename;
+   size_t fPosition;         ///< file offset of the next event
+   std::shared_ptr<TMMappedFile> fFile;
+};
+
+bool TMCanMmap(const char* source); ///< source is a plain local file that TMMmapReader can read
 
 TMEvent* TMReadEvent(TMReaderInterface* reader);
+bool TMReadEvent(TMReaderInterface* reader, TMEvent* event); ///< read next event into an existing event, reusing its buffers, false at end of file or on read error
+
+class TMEventPoolState; // free lists shared by the pool and the events it handed out
+
+class TMEventPool
+{
+ public:
+   TMEventPool(size_t max_free_events = 64); // ctor
+   ~TMEventPool(); // dtor
+   std::shared_ptr<TMEvent> NewEvent(); ///< empty event, recycled if possible, goes back to the pool when the last reference is dropped
+   std::shared_ptr<TMEvent> ReadEvent(TMReaderInterface* reader); ///< same as TMReadEvent() but fills a recycled event
+
+ public:
+   struct Stats
+   {
+      uint64_t events_allocated = 0;  ///< TMEvent objects created with new
+      uint64_t events_recycled  = 0;  ///< events handed out again from the free list
+      uint64_t events_returned  = 0;  ///< events put back on the free list
+      uint64_t events_deleted   = 0;  ///< events deleted because the free list was full
+      uint64_t blocks_allocated = 0;  ///< shared_ptr control blocks obtained from malloc
+      uint64_t buffer_grows     = 0;  ///< reads that had to grow TMEvent::data
+      size_t   events_free      = 0;  ///< events currently on the free list
+   };
+
+   Stats GetStats() const;
+
+ private:
+   std::shared_ptr<TMEventPoolState> fState;
+};
 void TMWriteEvent(TMWriterInterface* writer, const TMEvent* event);
 
 extern bool TMTraceCtorDtor;
@@ -7,5 +7,17 @@
 #pragma link C++ class MidasEventToJsonStage+;
 #pragma link C++ class MidasEventToByteStreamStage+;
 #pragma link C++ class MidasEventUnpackerStage+;
+#pragma link C++ class MidasEventToBankViewStage+;
+#pragma link C++ class MidasEventWriterStage+;
+#pragma link C++ class dataProducts::MidasBankView+;
+#pragma link C++ class dataProducts::ByteStreamBatch+;
+#pragma link C++ struct dataProducts::MidasEventHeaderRecord+;
+#pragma link C++ class dataProducts::MidasEventHeader+;
+#pragma link C++ class dataProducts::MidasEventHeaderBatch+;
+#pragma link C++ class dataProducts::LazyMidasEvent+;
+#pragma link C++ class dataProducts::LazyMidasEventBatch+;
+#pragma link C++ struct dataProducts::UnpackerPhaseStats+;
+#pragma link C++ struct dataProducts::UnpackerBankStats+;
+#pragma link C++ class dataProducts::UnpackerMetrics+;
 
 #endif
\ No newline at end of file
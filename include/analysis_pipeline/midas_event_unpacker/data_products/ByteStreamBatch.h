@@ -0,0 +1,35 @@
+#ifndef BYTE_STREAM_BATCH_H
+#define BYTE_STREAM_BATCH_H
+
+#include "analysis_pipeline/unpacker_core/data_products/DataProduct.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace dataProducts {
+
+/**
+ * ByteStreamBatch holds the data of one bank (name and type) for every event
+ * of a batch that contains it. Entry i points into event serialNumbers[i];
+ * owner keeps all events of the batch alive.
+ */
+class ByteStreamBatch : public DataProduct {
+public:
+    ByteStreamBatch();
+    ~ByteStreamBatch() override;
+
+    void Add(const uint8_t* bankData, size_t bankSize, uint32_t serialNumber);
+    size_t Size() const { return sizes.size(); }
+
+    std::vector<const uint8_t*> data;   //! Bank data per event, not owned
+    std::vector<uint64_t> sizes;        // Bank data size per event in bytes
+    std::vector<uint32_t> serialNumbers; // MIDAS serial number per event
+    std::shared_ptr<void> owner;        //! Keeps the batch events alive
+
+    ClassDefOverride(ByteStreamBatch, 1);
+};
+
+} // namespace dataProducts
+
+#endif // BYTE_STREAM_BATCH_H
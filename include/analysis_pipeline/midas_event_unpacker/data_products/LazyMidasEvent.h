@@ -0,0 +1,77 @@
+#ifndef LAZY_MIDAS_EVENT_H
+#define LAZY_MIDAS_EVENT_H
+
+#include "analysis_pipeline/unpacker_core/data_products/DataProduct.h"
+#include "analysis_pipeline/unpacker_core/data_products/ByteStream.h"
+#include "analysis_pipeline/midas_event_unpacker/selection/bank_selection.h"
+#include "midasio.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dataProducts {
+
+/**
+ * LazyMidasEvent hands out the banks of one event on demand. Only the bank
+ * index (TMEvent::BuildBankIndex) is built up front; the ByteStream or JSON
+ * of a bank is made the first time a consumer asks for it and then cached,
+ * so banks nobody reads cost nothing. Banks rejected by the stage's bank
+ * selection are reported as missing. Getters are thread safe.
+ */
+class LazyMidasEvent : public DataProduct {
+public:
+    LazyMidasEvent();
+    ~LazyMidasEvent() override;
+
+    void Assign(std::shared_ptr<TMEvent> event, std::shared_ptr<const BankSelection> selection);
+
+    // Names of the selected banks in event order
+    std::vector<std::string> BankNames() const;
+    bool HasBank(const std::string& name) const;
+
+    // nullptr if the bank is missing or not selected
+    std::shared_ptr<const ByteStream> GetByteStream(const std::string& name) const;
+
+    // Same object as in the event_json "banks" array, nullptr if missing or not selected
+    std::shared_ptr<const std::string> GetBankJson(const std::string& name) const;
+
+    // Banks materialized so far, as ByteStream or JSON
+    size_t NumMaterialized() const;
+
+    uint32_t serialNumber = 0;
+    uint16_t eventId = 0;
+
+private:
+    struct Entry {
+        uint32_t fourcc = 0;
+        std::shared_ptr<const ByteStream> stream;
+        std::shared_ptr<const std::string> json;
+    };
+
+    // nullptr if missing or not selected, caller holds mutex_
+    const TMBankRecord* findRecord(const std::string& name) const;
+    Entry& entry(uint32_t fourcc) const;
+
+    std::shared_ptr<TMEvent> event_;                 //! Owns the bank bytes
+    std::shared_ptr<const BankSelection> selection_; //!
+    mutable std::vector<Entry> entries_;             //! Materialized banks
+    mutable std::mutex mutex_;                       //!
+
+    ClassDefOverride(LazyMidasEvent, 1);
+};
+
+class LazyMidasEventBatch : public DataProduct {
+public:
+    LazyMidasEventBatch();
+    ~LazyMidasEventBatch() override;
+
+    std::vector<std::shared_ptr<LazyMidasEvent>> events; //!
+
+    ClassDefOverride(LazyMidasEventBatch, 1);
+};
+
+} // namespace dataProducts
+
+#endif // LAZY_MIDAS_EVENT_H
@@ -0,0 +1,145 @@
+#ifndef MIDAS_BANK_VIEW_H
+#define MIDAS_BANK_VIEW_H
+
+#include "analysis_pipeline/unpacker_core/data_products/DataProduct.h"
+#include "midasio.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+namespace dataProducts {
+
+/**
+ * Element type stored in a MIDAS bank of the given TID_* code. Banks whose
+ * TID has no numeric element type (arrays, structs, ...) are exposed as bytes.
+ */
+template <uint32_t TID> struct MidasTidType { using type = uint8_t; };
+template <> struct MidasTidType<TID_UINT8>    { using type = uint8_t; };
+template <> struct MidasTidType<TID_INT8>     { using type = int8_t; };
+template <> struct MidasTidType<TID_CHAR>     { using type = char; };
+template <> struct MidasTidType<TID_UINT16>   { using type = uint16_t; };
+template <> struct MidasTidType<TID_INT16>    { using type = int16_t; };
+template <> struct MidasTidType<TID_UINT32>   { using type = uint32_t; };
+template <> struct MidasTidType<TID_INT32>    { using type = int32_t; };
+template <> struct MidasTidType<TID_BOOL>     { using type = uint32_t; };
+template <> struct MidasTidType<TID_FLOAT>    { using type = float; };
+template <> struct MidasTidType<TID_DOUBLE>   { using type = double; };
+template <> struct MidasTidType<TID_BITFIELD> { using type = uint32_t; };
+template <> struct MidasTidType<TID_STRING>   { using type = char; };
+template <> struct MidasTidType<TID_INT64>    { using type = int64_t; };
+template <> struct MidasTidType<TID_UINT64>   { using type = uint64_t; };
+
+/**
+ * Read-only typed range over bank memory. Element loads go through memcpy,
+ * so the span is valid for misaligned banks too; the compiler emits plain
+ * loads for the aligned case.
+ */
+template <typename T>
+class MidasBankSpan {
+public:
+    using value_type = T;
+
+    MidasBankSpan(const char* bytes, size_t count) : bytes_(bytes), count_(count) {}
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    T operator[](size_t i) const {
+        T value;
+        std::memcpy(&value, bytes_ + i * sizeof(T), sizeof(T));
+        return value;
+    }
+
+    // Direct pointer access, nullptr unless the memory is aligned for T
+    const T* data() const {
+        return reinterpret_cast<uintptr_t>(bytes_) % alignof(T) == 0
+            ? reinterpret_cast<const T*>(bytes_) : nullptr;
+    }
+
+private:
+    const char* bytes_;
+    size_t count_;
+};
+
+/**
+ * MidasBankView is a typed, read-only view of one MIDAS bank. It points
+ * straight into the event memory; owner keeps that memory alive.
+ */
+class MidasBankView : public DataProduct {
+public:
+    MidasBankView();
+    ~MidasBankView() override;
+
+    // Fill from a bank of event; sets element size/count and alignment
+    void Assign(const std::string& bankName, uint32_t bankType, const char* bankData,
+                uint32_t bankSize, std::shared_ptr<void> bankOwner);
+
+    // True if T is the element type of this bank's TID
+    template <typename T>
+    bool Is() const {
+        return Visit([](auto span) {
+            return std::is_same_v<typename decltype(span)::value_type, T>;
+        });
+    }
+
+    // Typed pointer, nullptr on type mismatch or misaligned data
+    template <typename T>
+    const T* As() const {
+        return (Is<T>() && aligned) ? reinterpret_cast<const T*>(data) : nullptr;
+    }
+
+    // Typed span, empty on type mismatch
+    template <typename T>
+    MidasBankSpan<T> Span() const {
+        return Is<T>() ? MidasBankSpan<T>(data, elementCount) : MidasBankSpan<T>(data, 0);
+    }
+
+    // Dispatch once on the TID and call visitor with the matching MidasBankSpan<T>
+    template <typename Visitor>
+    decltype(auto) Visit(Visitor&& visitor) const {
+        switch (type) {
+            case TID_UINT8:    return visitor(SpanOf<TID_UINT8>());
+            case TID_INT8:     return visitor(SpanOf<TID_INT8>());
+            case TID_CHAR:     return visitor(SpanOf<TID_CHAR>());
+            case TID_UINT16:   return visitor(SpanOf<TID_UINT16>());
+            case TID_INT16:    return visitor(SpanOf<TID_INT16>());
+            case TID_UINT32:   return visitor(SpanOf<TID_UINT32>());
+            case TID_INT32:    return visitor(SpanOf<TID_INT32>());
+            case TID_BOOL:     return visitor(SpanOf<TID_BOOL>());
+            case TID_FLOAT:    return visitor(SpanOf<TID_FLOAT>());
+            case TID_DOUBLE:   return visitor(SpanOf<TID_DOUBLE>());
+            case TID_BITFIELD: return visitor(SpanOf<TID_BITFIELD>());
+            case TID_STRING:   return visitor(SpanOf<TID_STRING>());
+            case TID_INT64:    return visitor(SpanOf<TID_INT64>());
+            case TID_UINT64:   return visitor(SpanOf<TID_UINT64>());
+            default:           return visitor(SpanOf<0>());
+        }
+    }
+
+    // Element size in bytes for a TID_* code
+    static size_t ElementSize(uint32_t tid);
+
+    std::string name;           // Bank name
+    uint32_t type = 0;          // TID_* code
+    uint32_t dataSize = 0;      // Bank data size in bytes
+    size_t elementSize = 1;     // Bytes per element
+    size_t elementCount = 0;    // Number of whole elements in the bank
+    bool aligned = false;       // Data is aligned for the element type
+    const char* data = nullptr; //! Bank data, not owned
+    std::shared_ptr<void> owner; //! Keeps the event memory alive
+
+private:
+    template <uint32_t TID>
+    MidasBankSpan<typename MidasTidType<TID>::type> SpanOf() const {
+        return MidasBankSpan<typename MidasTidType<TID>::type>(data, elementCount);
+    }
+
+    ClassDefOverride(MidasBankView, 1);
+};
+
+} // namespace dataProducts
+
+#endif // MIDAS_BANK_VIEW_H
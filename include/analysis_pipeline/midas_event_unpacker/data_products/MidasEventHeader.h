@@ -0,0 +1,52 @@
+#ifndef MIDAS_EVENT_HEADER_H
+#define MIDAS_EVENT_HEADER_H
+
+#include "analysis_pipeline/unpacker_core/data_products/DataProduct.h"
+#include "midasio.h"
+#include <cstdint>
+#include <vector>
+
+namespace dataProducts {
+
+/**
+ * Fixed-layout copy of the MIDAS event header plus the bank count,
+ * the binary replacement for the event_metadata JSON. With a bank
+ * selection numBanks counts the selected banks only.
+ */
+struct MidasEventHeaderRecord {
+    uint16_t eventId = 0;
+    uint16_t triggerMask = 0;
+    uint32_t serialNumber = 0;
+    uint32_t timeStamp = 0;
+    uint32_t dataSize = 0;
+    uint32_t eventHeaderSize = 0;
+    uint32_t bankHeaderFlags = 0;
+    uint32_t numBanks = 0;
+
+    static MidasEventHeaderRecord FromEvent(const TMEvent& event);
+    static MidasEventHeaderRecord FromEvent(const TMEvent& event, uint32_t numBanks);
+};
+
+class MidasEventHeader : public DataProduct {
+public:
+    MidasEventHeader();
+    ~MidasEventHeader() override;
+
+    MidasEventHeaderRecord header;
+
+    ClassDefOverride(MidasEventHeader, 1);
+};
+
+class MidasEventHeaderBatch : public DataProduct {
+public:
+    MidasEventHeaderBatch();
+    ~MidasEventHeaderBatch() override;
+
+    std::vector<MidasEventHeaderRecord> headers;
+
+    ClassDefOverride(MidasEventHeaderBatch, 1);
+};
+
+} // namespace dataProducts
+
+#endif // MIDAS_EVENT_HEADER_H
@@ -0,0 +1,62 @@
+#ifndef UNPACKER_METRICS_H
+#define UNPACKER_METRICS_H
+
+#include "analysis_pipeline/unpacker_core/data_products/DataProduct.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dataProducts {
+
+// Latency of one phase of MidasEventUnpackerStage::Process, in nanoseconds
+struct UnpackerPhaseStats {
+    std::string phase;
+    uint64_t count = 0;
+    uint64_t totalNs = 0;
+    uint64_t maxNs = 0;
+    uint64_t p50Ns = 0;
+    uint64_t p90Ns = 0;
+    uint64_t p99Ns = 0;
+    std::vector<uint64_t> bucketUpperNs;  // non-empty histogram buckets only
+    std::vector<uint64_t> bucketCounts;
+};
+
+// Banks unpacked under one bank name
+struct UnpackerBankStats {
+    std::string name;
+    uint64_t events = 0;  // events containing the bank
+    uint64_t banks = 0;
+    uint64_t bytes = 0;
+};
+
+/**
+ * Snapshot of the instrumentation of one unpacker stage, published as
+ * "unpacker_metrics_<stage name>" every "metrics_interval" events or taken
+ * with MidasEventUnpackerStage::GetMetrics(). All counters run from the
+ * start of the stage.
+ */
+class UnpackerMetrics : public DataProduct {
+public:
+    UnpackerMetrics();
+    ~UnpackerMetrics() override;
+
+    std::string ToJson() const;
+
+    std::string stageName;
+    bool enabled = false;          // false if built without MIDAS_UNPACKER_INSTRUMENTATION
+    uint64_t events = 0;           // events processed
+    uint64_t rejectedEvents = 0;   // events dropped by the bank selection
+    uint64_t batches = 0;
+    uint64_t eventBytes = 0;
+    uint64_t banks = 0;            // banks selected for unpacking
+    uint64_t bankBytes = 0;
+    uint64_t productsPublished = 0;
+    std::vector<UnpackerPhaseStats> phases;
+    std::vector<UnpackerBankStats> bankStats;
+
+    ClassDefOverride(UnpackerMetrics, 1);
+};
+
+} // namespace dataProducts
+
+#endif // UNPACKER_METRICS_H
@@ -0,0 +1,71 @@
+#ifndef MIDAS_EVENT_UNPACKER_LATENCY_HISTOGRAM_H
+#define MIDAS_EVENT_UNPACKER_LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Fixed-bucket log-linear latency histogram in nanoseconds. Values below 16
+ * get one bucket each; above that every power of two is split into 16
+ * buckets, so a bucket is at most 1/16 (6.25%) wide relative to its value.
+ * Values from 2^40 ns (~18 min) up share the last bucket.
+ *
+ * Record() is wait-free for a single writer thread; snapshots (Count,
+ * Percentile, ...) can be taken from any thread and may be a few records
+ * behind.
+ */
+class LatencyHistogram {
+public:
+    static constexpr unsigned kSubBucketBits = 4;
+    static constexpr unsigned kSubBuckets = 1u << kSubBucketBits;
+    static constexpr unsigned kMaxExponent = 40;
+    static constexpr size_t kNumBuckets = kSubBuckets + (kMaxExponent - kSubBucketBits) * kSubBuckets;
+
+    void Record(uint64_t ns) {
+        bump(buckets_[BucketIndex(ns)], 1);
+        bump(count_, 1);
+        bump(sum_, ns);
+        if (ns > max_.load(std::memory_order_relaxed)) {
+            max_.store(ns, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t Sum() const { return sum_.load(std::memory_order_relaxed); }
+    uint64_t Max() const { return max_.load(std::memory_order_relaxed); }
+    uint64_t BucketCount(size_t index) const { return buckets_[index].load(std::memory_order_relaxed); }
+
+    // Upper bound of the bucket holding the q-quantile (0 <= q <= 1), 0 if empty
+    uint64_t Percentile(double q) const;
+
+    static size_t BucketIndex(uint64_t ns) {
+        if (ns < kSubBuckets) {
+            return static_cast<size_t>(ns);
+        }
+        unsigned exponent = 63 - __builtin_clzll(ns);
+        if (exponent >= kMaxExponent) {
+            return kNumBuckets - 1;
+        }
+        unsigned shift = exponent - kSubBucketBits;
+        size_t sub = (ns >> shift) & (kSubBuckets - 1);
+        return kSubBuckets + shift * kSubBuckets + sub;
+    }
+
+    static uint64_t BucketLowerBound(size_t index);
+    static uint64_t BucketUpperBound(size_t index);
+
+private:
+    // Only the writer thread modifies, so a relaxed load and store is enough
+    // and avoids a locked read-modify-write on the hot path
+    static void bump(std::atomic<uint64_t>& counter, uint64_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> buckets_[kNumBuckets] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+#endif // MIDAS_EVENT_UNPACKER_LATENCY_HISTOGRAM_H
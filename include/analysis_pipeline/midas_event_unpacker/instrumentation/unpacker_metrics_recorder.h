@@ -0,0 +1,107 @@
+#ifndef MIDAS_EVENT_UNPACKER_METRICS_RECORDER_H
+#define MIDAS_EVENT_UNPACKER_METRICS_RECORDER_H
+
+#include "analysis_pipeline/midas_event_unpacker/data_products/UnpackerMetrics.h"
+#include <cstdint>
+
+// 0 (CMake option MIDAS_UNPACKER_INSTRUMENTATION=OFF) compiles all timers,
+// histograms and counters out of the stages. It changes the stage layout, so
+// it must match the library build; the CMake target exports it.
+#ifndef MIDAS_UNPACKER_INSTRUMENTATION
+#error "MIDAS_UNPACKER_INSTRUMENTATION is not defined: link the midas_event_unpacker CMake target or define it to 0 or 1 as the library was built"
+#endif
+
+#if MIDAS_UNPACKER_INSTRUMENTATION
+#include "analysis_pipeline/midas_event_unpacker/instrumentation/latency_histogram.h"
+#include <atomic>
+#include <chrono>
+#endif
+
+// Phases of one MidasEventUnpackerStage::Process call
+enum class UnpackerPhase : unsigned {
+    kScan,      // bank scan and selection (selectBanks)
+    kBuild,     // product construction: everything not in the other phases
+    kPublish,   // DataProductManager insertion
+    kTotal,     // the whole Process call
+    kNumPhases
+};
+
+const char* UnpackerPhaseName(UnpackerPhase phase);
+
+#if MIDAS_UNPACKER_INSTRUMENTATION
+
+/**
+ * Per-stage instrumentation: a LatencyHistogram per phase plus event, bank
+ * and per-bank-name counters. Recording is wait-free and allocation-free
+ * for the single thread running the stage; Snapshot() may run on any thread.
+ */
+class UnpackerMetricsRecorder {
+public:
+    static uint64_t Now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void RecordPhase(UnpackerPhase phase, uint64_t ns) { phases_[static_cast<unsigned>(phase)].Record(ns); }
+
+    void CountEvent(uint64_t bytes) { bump(events_, 1); bump(eventBytes_, bytes); }
+    void CountRejectedEvent() { bump(rejectedEvents_, 1); }
+    void CountBatch() { bump(batches_, 1); }
+    void CountProducts(uint64_t n) { bump(products_, n); }
+
+    // Call once per event before its CountBank() calls
+    void BeginEventBanks() { ++bankScanSeq_; }
+    void CountBank(uint32_t fourcc, uint64_t bytes);
+
+    void Snapshot(dataProducts::UnpackerMetrics& out) const;
+
+private:
+    // distinct bank names tracked; the rest, and the all-zero name, count as "????"
+    static constexpr unsigned kBankSlots = 256;
+
+    struct BankSlot {
+        std::atomic<uint32_t> fourcc{0};   // 0 = free
+        std::atomic<uint64_t> events{0};
+        std::atomic<uint64_t> banks{0};
+        std::atomic<uint64_t> bytes{0};
+        uint64_t lastSeq = 0;              // writer only, counts each event once
+    };
+
+    static void bump(std::atomic<uint64_t>& counter, uint64_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    BankSlot& slot(uint32_t fourcc);
+
+    LatencyHistogram phases_[static_cast<unsigned>(UnpackerPhase::kNumPhases)];
+    std::atomic<uint64_t> events_{0};
+    std::atomic<uint64_t> rejectedEvents_{0};
+    std::atomic<uint64_t> batches_{0};
+    std::atomic<uint64_t> eventBytes_{0};
+    std::atomic<uint64_t> banks_{0};
+    std::atomic<uint64_t> bankBytes_{0};
+    std::atomic<uint64_t> products_{0};
+    uint64_t bankScanSeq_ = 0;
+    BankSlot slots_[kBankSlots];
+    BankSlot overflow_;
+};
+
+#else
+
+// Instrumentation compiled out: same interface, no state, no work
+class UnpackerMetricsRecorder {
+public:
+    static uint64_t Now() { return 0; }
+    void RecordPhase(UnpackerPhase, uint64_t) {}
+    void CountEvent(uint64_t) {}
+    void CountRejectedEvent() {}
+    void CountBatch() {}
+    void CountProducts(uint64_t) {}
+    void BeginEventBanks() {}
+    void CountBank(uint32_t, uint64_t) {}
+    void Snapshot(dataProducts::UnpackerMetrics& out) const { out.enabled = false; }
+};
+
+#endif // MIDAS_UNPACKER_INSTRUMENTATION
+
+#endif // MIDAS_EVENT_UNPACKER_METRICS_RECORDER_H
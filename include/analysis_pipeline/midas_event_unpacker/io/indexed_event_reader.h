@@ -0,0 +1,77 @@
+#ifndef MIDAS_EVENT_UNPACKER_INDEXED_EVENT_READER_H
+#define MIDAS_EVENT_UNPACKER_INDEXED_EVENT_READER_H
+
+#include "analysis_pipeline/midas_event_unpacker/io/midas_event_index.h"
+#include "midasio.h"
+#include <memory>
+#include <string>
+
+class Lz4BlockReader;
+
+/**
+ * IndexedEventReader reads the events of one MIDAS file in any order using
+ * a MidasEventIndex. Seek() positions the reader on an index entry; Next()
+ * then reads forward, within the range given to SetRange() if any.
+ * Sequential Next() calls do not seek, so reading a range costs the same as
+ * a plain TMReadEvent() loop once the reader is positioned.
+ *
+ * A reader owns its own file handle and decompression state and is not
+ * thread safe; parallel consumers each open a reader on the same shared
+ * index (see MidasEventIndex::Shards()).
+ */
+class IndexedEventReader {
+public:
+    IndexedEventReader(const std::string& filename, std::shared_ptr<const MidasEventIndex> index);
+    ~IndexedEventReader();
+
+    IndexedEventReader(const IndexedEventReader&) = delete;
+    IndexedEventReader& operator=(const IndexedEventReader&) = delete;
+
+    // Next() returns entry i next. Throws std::out_of_range past the end of the index.
+    void Seek(size_t entry);
+
+    // Limit Next() to a range and seek to its first event. Next() skips
+    // entries the range does not contain (see MidasEventRange::Contains()).
+    void SetRange(const MidasEventRange& range);
+
+    // Next event, nullptr at the end of the range or on error
+    std::shared_ptr<TMEvent> Next();
+
+    // Seek(entry) and read that event, ignoring the range
+    std::shared_ptr<TMEvent> ReadAt(size_t entry);
+
+    // First event with this serial number, nullptr if the index has none
+    std::shared_ptr<TMEvent> ReadSerial(uint32_t serialNumber);
+
+    // Index entry of the event the next Next() returns
+    size_t Position() const { return next_; }
+
+    const MidasEventIndex& Index() const { return *index_; }
+
+    // Set when reading stopped on an error, including events that do not
+    // match their index entry (the file changed after it was indexed)
+    bool HasError() const { return error_; }
+    const std::string& ErrorString() const { return errorString_; }
+
+private:
+    bool PositionAt(size_t entry);
+    std::shared_ptr<TMEvent> ReadNext();
+    void Fail(const std::string& message);
+
+    std::string filename_;
+    std::shared_ptr<const MidasEventIndex> index_;
+    std::unique_ptr<TMReaderInterface> reader_;
+    Lz4BlockReader* lz4Reader_ = nullptr;  // reader_ when the file is .lz4
+    TMEventPool pool_;
+
+    size_t next_ = 0;           // entry Next() returns
+    size_t end_ = 0;            // end of the range
+    MidasEventRange range_;     // serial filter of the range
+    size_t positioned_ = 0;     // entry reader_ is positioned at
+    uint64_t streamOffset_ = 0; // decoded offset of reader_ for gzip files
+
+    bool error_ = false;
+    std::string errorString_;
+};
+
+#endif // MIDAS_EVENT_UNPACKER_INDEXED_EVENT_READER_H
@@ -0,0 +1,88 @@
+#ifndef MIDAS_EVENT_UNPACKER_LZ4_BLOCK_READER_H
+#define MIDAS_EVENT_UNPACKER_LZ4_BLOCK_READER_H
+
+#include "midasio.h"
+#include "mxxhash.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * Lz4BlockReader decodes an LZ4 frame file one block at a time with the raw
+ * block API instead of the streaming frame decoder, so it can report where
+ * each decoded byte came from and restart decoding at any block.
+ *
+ * Frames with independent blocks (what the MIDAS loggers write) can be
+ * entered at any block. Linked-block frames have to be entered at their first
+ * block, because each block refers back to the previous 64 kB of output.
+ *
+ * The content checksum covers a whole frame, so it is verified when a frame
+ * decoded from its first block reaches its end; a reader that entered the
+ * frame at a later block can only check the block checksums.
+ */
+class Lz4BlockReader : public TMReaderInterface {
+public:
+    // Where the next decoded byte comes from
+    struct Position {
+        uint64_t frameOffset = 0;  // file offset of the frame header
+        uint64_t blockOffset = 0;  // file offset of the block to start decoding at
+        uint64_t blockSkip = 0;    // decoded bytes to discard from there
+    };
+
+    explicit Lz4BlockReader(const std::string& filename);
+    ~Lz4BlockReader() override;
+
+    Lz4BlockReader(const Lz4BlockReader&) = delete;
+    Lz4BlockReader& operator=(const Lz4BlockReader&) = delete;
+
+    int Read(void* buf, int count) override;
+    int Close() override;
+
+    // Position of the next byte Read() returns; false at end of file or on error.
+    // For linked-block frames the position is the start of the frame.
+    bool Tell(Position* position);
+
+    // Continue decoding at a position obtained from Tell(), possibly in
+    // another reader of the same file.
+    bool Seek(const Position& position);
+
+    // Discard decoded bytes without copying them out; returns the number skipped
+    uint64_t Skip(uint64_t count);
+
+    // Decoded bytes consumed since the start of the file or the last Seek()
+    uint64_t DecodedOffset() const { return decodedOffset_; }
+
+private:
+    bool ReadFrameHeader();
+    bool ReadBlock();
+    bool ReadFully(void* buf, size_t count, const char* what);
+    bool SeekFile(uint64_t offset);
+    void Fail(const std::string& message);
+
+    std::string filename_;
+    FILE* fp_ = nullptr;
+    uint64_t fileOffset_ = 0;       // file offset of the next undecoded byte
+
+    bool inFrame_ = false;
+    uint64_t frameOffset_ = 0;
+    uint64_t frameFirstBlock_ = 0;
+    uint64_t frameDecoded_ = 0;     // decoded bytes consumed since the start of the frame
+    bool blockIndependent_ = true;
+    bool blockChecksum_ = false;
+    bool contentChecksum_ = false;
+    bool contentHashed_ = false;    // decoding started at the first block, contentHash_ covers the frame
+    XXH32_state_t contentHash_;
+    size_t blockMaxSize_ = 0;
+
+    uint64_t blockOffset_ = 0;      // file offset of the block in block_
+    std::vector<char> src_;
+    std::vector<char> block_;       // decoded block
+    size_t blockSize_ = 0;
+    size_t blockPos_ = 0;
+    std::vector<char> history_;     // last 64 kB of output, linked-block frames only
+
+    uint64_t decodedOffset_ = 0;
+};
+
+#endif // MIDAS_EVENT_UNPACKER_LZ4_BLOCK_READER_H
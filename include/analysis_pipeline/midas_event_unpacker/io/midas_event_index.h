@@ -0,0 +1,131 @@
+#ifndef MIDAS_EVENT_UNPACKER_MIDAS_EVENT_INDEX_H
+#define MIDAS_EVENT_UNPACKER_MIDAS_EVENT_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * One event of an indexed MIDAS file. For .lz4 files the event is found by
+ * decoding from blockOffset (a block of the frame at frameOffset) and
+ * discarding blockSkip bytes; for uncompressed files offset is the file
+ * offset. The layout is the on-disk record of the sidecar file.
+ */
+struct MidasEventIndexEntry {
+    uint64_t offset = 0;        // offset in the decoded event stream
+    uint64_t frameOffset = 0;   // .lz4 only: file offset of the frame header
+    uint64_t blockOffset = 0;   // .lz4 only: file offset of the block decoding starts at
+    uint64_t blockSkip = 0;     // .lz4 only: decoded bytes from blockOffset to the event
+    uint32_t serialNumber = 0;
+    uint32_t timeStamp = 0;
+    uint32_t size = 0;          // event header included
+    uint16_t eventId = 0;
+    uint16_t triggerMask = 0;
+};
+
+static_assert(sizeof(MidasEventIndexEntry) == 48, "MidasEventIndexEntry is an on-disk record");
+
+// Half-open range of index entries [begin, end). A range from SerialRange()
+// also carries its serial numbers, and IndexedEventReader skips the entries
+// in between that do not match (files whose serials are not sorted).
+struct MidasEventRange {
+    size_t begin = 0;
+    size_t end = 0;
+    uint64_t bytes = 0;  // decoded bytes covered by the range
+    bool serialFiltered = false;
+    uint32_t firstSerial = 0;
+    uint32_t lastSerial = 0;
+
+    bool Contains(const MidasEventIndexEntry& entry) const {
+        return !serialFiltered || (entry.serialNumber >= firstSerial && entry.serialNumber <= lastSerial);
+    }
+
+    size_t Size() const { return end - begin; }
+    bool Empty() const { return begin == end; }
+};
+
+/**
+ * MidasEventIndex records the position of every event of a .mid, .mid.lz4 or
+ * .mid.gz file, so IndexedEventReader can seek straight to an event or range
+ * and a run can be split into shards that threads unpack independently.
+ *
+ * The index is kept in a sidecar file next to the data ("run00042.mid.lz4.idx"),
+ * stamped with the size and modification time of the data file. LoadOrBuild()
+ * uses the sidecar when it matches and otherwise indexes the file in a first
+ * pass and saves the result for later runs:
+ *
+ *   auto index = std::make_shared<MidasEventIndex>(MidasEventIndex::LoadOrBuild(filename));
+ *   for (const auto& shard : index->Shards(nthreads)) {
+ *       workers.emplace_back([=] {
+ *           IndexedEventReader reader(filename, index);
+ *           reader.SetRange(shard);
+ *           while (auto event = reader.Next()) { ... }
+ *       });
+ *   }
+ *
+ * Random access is cheap for uncompressed files and for LZ4 frames with
+ * independent blocks. Linked-block LZ4 frames are entered at the frame start,
+ * and gzip files are decoded from the start of the file up to the event.
+ */
+class MidasEventIndex {
+public:
+    enum class Compression : uint32_t { kNone = 0, kLz4 = 1, kGzip = 2 };
+
+    static constexpr uint32_t kVersion = 1;
+
+    // Sidecar path used when none is given: filename + ".idx"
+    static std::string DefaultPath(const std::string& filename);
+    static Compression CompressionFor(const std::string& filename);
+
+    // Index a file in one sequential pass. Throws std::runtime_error on
+    // unreadable or corrupted input.
+    static MidasEventIndex Build(const std::string& filename);
+
+    // Load a sidecar; false (with the reason in error) if it is missing,
+    // unreadable, of another version or stale with respect to filename.
+    static bool Load(const std::string& filename, const std::string& indexPath,
+                     MidasEventIndex* index, std::string* error);
+
+    // Load the sidecar if it is valid, otherwise Build() and Save(). A sidecar
+    // that cannot be written (read-only directory) is only logged.
+    static MidasEventIndex LoadOrBuild(const std::string& filename, const std::string& indexPath = "");
+
+    // Written to a temporary file and renamed, so concurrent runs never see a partial index
+    bool Save(const std::string& indexPath, std::string* error) const;
+
+    const std::string& Filename() const { return filename_; }
+    Compression GetCompression() const { return compression_; }
+    size_t Size() const { return entries_.size(); }
+    bool Empty() const { return entries_.empty(); }
+    const MidasEventIndexEntry& operator[](size_t i) const { return entries_[i]; }
+    const std::vector<MidasEventIndexEntry>& Entries() const { return entries_; }
+
+    // Decoded size of the whole event stream
+    uint64_t Bytes() const;
+
+    // Entry of the first event with this serial number, Size() if there is none
+    size_t FindSerial(uint32_t serialNumber) const;
+
+    // Events with first <= serial_number <= last. Uses a binary search when
+    // serial numbers increase through the file (the usual case), a scan otherwise;
+    // then the range spans the first to the last match and Size() counts the
+    // entries in between too.
+    MidasEventRange SerialRange(uint32_t first, uint32_t last) const;
+
+    MidasEventRange Range(size_t begin, size_t end) const;
+
+    // Split all events into at most n contiguous ranges of about equal decoded size
+    std::vector<MidasEventRange> Shards(size_t n) const;
+
+private:
+    void Append(const MidasEventIndexEntry& entry);
+
+    std::string filename_;
+    Compression compression_ = Compression::kNone;
+    uint64_t sourceSize_ = 0;
+    int64_t sourceMtimeNs_ = 0;
+    bool serialsSorted_ = true;
+    std::vector<MidasEventIndexEntry> entries_;
+};
+
+#endif // MIDAS_EVENT_UNPACKER_MIDAS_EVENT_INDEX_H
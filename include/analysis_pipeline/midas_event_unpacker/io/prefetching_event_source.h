@@ -0,0 +1,103 @@
+#ifndef MIDAS_EVENT_UNPACKER_PREFETCHING_EVENT_SOURCE_H
+#define MIDAS_EVENT_UNPACKER_PREFETCHING_EVENT_SOURCE_H
+
+#include "analysis_pipeline/midas_event_unpacker/io/spsc_queue.h"
+#include "analysis_pipeline/midas_event_unpacker/instrumentation/unpacker_metrics_recorder.h"
+#include "analysis_pipeline/midas_event_unpacker/instrumentation/latency_histogram.h"
+#include "midasio.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+/**
+ * PrefetchingEventSource reads a MIDAS file on a dedicated producer thread.
+ * Reading, decompression and FindAllBanks() run there, and ready events are
+ * handed to the consumer through a bounded SpscQueue, so I/O overlaps with
+ * unpacking. The producer blocks when the queue is full (backpressure).
+ *
+ * Typical use feeds MidasEventUnpackerStage:
+ *
+ *   PrefetchingEventSource source("run00042.mid.lz4");
+ *   source.Start();
+ *   while (auto event = source.Next()) {
+ *       InputBundle input;
+ *       input.set("TMEvent", event);
+ *       stage.SetInput(input);
+ *       stage.Process();
+ *   }
+ */
+class PrefetchingEventSource {
+public:
+    struct Options {
+        size_t queueDepth = 256;    // events buffered between producer and consumer
+        size_t poolSize = 0;        // recycled events kept by the TMEventPool, 0 = 2 * queueDepth
+        bool useMmap = true;        // zero-copy TMMmapReader for plain local files
+        bool findAllBanks = true;   // scan banks on the producer thread
+    };
+
+    struct Stats {
+        uint64_t eventsProduced = 0;
+        uint64_t eventsConsumed = 0;
+        uint64_t producerStallNs = 0;  // time the producer waited on a full queue (CPU-bound downstream)
+        uint64_t consumerStallNs = 0;  // time the consumer waited on an empty queue (I/O-bound upstream)
+        size_t occupancy = 0;          // events in the queue right now
+        size_t maxOccupancy = 0;
+        double meanOccupancy = 0.0;    // averaged over Next() calls
+        size_t queueDepth = 0;
+    };
+
+    explicit PrefetchingEventSource(const std::string& filename);
+    PrefetchingEventSource(const std::string& filename, const Options& options);
+    ~PrefetchingEventSource();
+
+    PrefetchingEventSource(const PrefetchingEventSource&) = delete;
+    PrefetchingEventSource& operator=(const PrefetchingEventSource&) = delete;
+
+    // Starts the producer thread. A source reads its file once: a second
+    // Start(), also after Stop(), throws std::logic_error.
+    void Start();
+    void Stop();
+
+    // Next event in file order; blocks while the queue is empty, nullptr at end of input
+    std::shared_ptr<TMEvent> Next();
+
+    Stats GetStats() const;
+
+    // Per-event latency on the producer thread: TMReadEvent plus decompression,
+    // and FindAllBanks. Empty when built without MIDAS_UNPACKER_INSTRUMENTATION.
+    const LatencyHistogram& ReadLatency() const { return readLatency_; }
+    const LatencyHistogram& ScanLatency() const { return scanLatency_; }
+
+    // Set when reading stopped on an error rather than at end of file
+    bool HasError() const { return error_.load(std::memory_order_acquire); }
+    std::string ErrorString() const;
+
+private:
+    void Produce();
+    std::shared_ptr<TMEvent> ReadOne(TMReaderInterface* reader, TMMmapReader* mmapReader, TMEventPool& pool);
+    void Fail(const std::string& message);
+
+    std::string filename_;
+    Options options_;
+    SpscQueue<std::shared_ptr<TMEvent>> queue_;
+
+    std::thread producer_;
+    bool started_ = false;
+    std::atomic<bool> stop_{false};
+    std::atomic<bool> done_{false};
+    std::atomic<bool> error_{false};
+    std::string errorString_;  // written by the producer before error_ is set
+
+    std::atomic<uint64_t> produced_{0};
+    std::atomic<uint64_t> consumed_{0};
+    std::atomic<uint64_t> producerStallNs_{0};
+    std::atomic<uint64_t> consumerStallNs_{0};
+    std::atomic<uint64_t> occupancySum_{0};
+    std::atomic<size_t> maxOccupancy_{0};
+    LatencyHistogram readLatency_;   // written by the producer only
+    LatencyHistogram scanLatency_;
+};
+
+#endif // MIDAS_EVENT_UNPACKER_PREFETCHING_EVENT_SOURCE_H
@@ -0,0 +1,157 @@
+#ifndef MIDAS_EVENT_UNPACKER_SHM_EVENT_RING_H
+#define MIDAS_EVENT_UNPACKER_SHM_EVENT_RING_H
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <signal.h>
+
+/**
+ * Layout of the POSIX shared-memory event ring shared by ShmEventRingProducer
+ * and ShmEventSource. The segment holds a header, a descriptor per slot and
+ * the slot data. A slot carries a batch of MIDAS events (header included,
+ * each padded to 8 bytes) so the handshake cost is paid per slot rather
+ * than per event.
+ *
+ * Slot states: the producer fills any kFree slot, stamps it with the next
+ * sequence number and stores kReady; the consumer takes kReady slots in
+ * sequence order and marks them kInUse; the slot goes back to kFree when the
+ * last event viewing it is dropped, which can be out of order. A slot held
+ * downstream therefore only takes itself out of the rotation, and
+ * ShmEventSource copies events out rather than let views hold more than
+ * slotCount - kFreeSlotsKept slots, so the ring cannot seize up.
+ *
+ * Each side records its pid, and a side that waits checks now and then that
+ * the other is still alive instead of waiting forever on a crashed process.
+ */
+namespace shm_ring {
+
+constexpr uint64_t kMagic = 0x474e495253414d44ull;  // "DMASRING"
+constexpr uint32_t kVersion = 2;
+constexpr size_t kEventAlign = 8;
+constexpr uint32_t kFreeSlotsKept = 2;         // slots event views may never hold
+constexpr unsigned kLivenessCheckPeriod = 4096; // Backoff() rounds between liveness checks, ~80 ms
+
+enum SlotState : uint32_t { kFree = 0, kReady = 1, kInUse = 2 };
+
+struct alignas(64) Header {
+    std::atomic<uint64_t> magic;      // stored last, once the segment is initialized
+    uint32_t version;
+    uint32_t slotCount;
+    uint64_t slotSize;                // data bytes per slot
+    uint64_t dataOffset;              // segment offset of slot 0 data
+    std::atomic<uint32_t> producerDone;
+    std::atomic<uint32_t> consumers;  // attached ShmEventSources, informational
+    std::atomic<int32_t> producerPid;
+    std::atomic<int32_t> consumerPid; // 0 while no consumer is attached
+    alignas(64) std::atomic<uint64_t> slotsPublished;
+    std::atomic<uint64_t> eventsPublished;
+    std::atomic<uint64_t> bytesPublished;
+};
+
+struct alignas(64) Slot {
+    std::atomic<uint32_t> state;
+    uint32_t numEvents;
+    uint64_t bytes;                   // used data bytes, padding included
+    uint64_t sequence;                // order in which the consumer takes the slot
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "the ring needs address-free atomics to be shared between processes");
+
+inline size_t PaddedEventSize(size_t size) { return (size + kEventAlign - 1) & ~(kEventAlign - 1); }
+inline size_t SlotTableOffset() { return sizeof(Header); }
+inline size_t DataOffset(uint32_t slotCount) {
+    size_t end = SlotTableOffset() + slotCount * sizeof(Slot);
+    return (end + 4095) & ~size_t(4095);
+}
+inline size_t SegmentSize(uint32_t slotCount, uint64_t slotSize) {
+    return DataOffset(slotCount) + slotCount * slotSize;
+}
+
+// Waiting on the other process: spin briefly, then yield, then sleep
+inline void Backoff(unsigned& attempt) {
+    if (attempt < 64) {
+        // busy wait
+    } else if (attempt < 128) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(20));
+    }
+    ++attempt;
+}
+
+// False once pid has exited; 0 (not attached) counts as alive
+inline bool ProcessAlive(int32_t pid) {
+    return pid <= 0 || kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+} // namespace shm_ring
+
+/**
+ * ShmEventRingProducer creates the shared-memory ring and publishes MIDAS
+ * events into it. Write() copies one event in; Reserve()/Commit() let a
+ * producer build or receive the event directly in ring memory. Events are
+ * visible to the consumer when their slot is full or on Flush().
+ *
+ *   ShmEventRingProducer ring("/midas_events", 16, 4 << 20);
+ *   while (...) ring.Write(event.EventBytes(), event.EventSize());
+ *   ring.Close();   // consumers drain the ring and then see end of input
+ */
+class ShmEventRingProducer {
+public:
+    // Creates (replacing a stale segment of the same name) and maps the ring.
+    // Throws std::runtime_error on failure.
+    ShmEventRingProducer(const std::string& name, uint32_t slotCount, uint64_t slotSize);
+    ~ShmEventRingProducer();
+
+    ShmEventRingProducer(const ShmEventRingProducer&) = delete;
+    ShmEventRingProducer& operator=(const ShmEventRingProducer&) = delete;
+
+    // Space for an event of size bytes, blocks while no slot is free.
+    // Throws std::length_error if the event cannot fit in a slot, and
+    // std::runtime_error if the consumer exits while the ring is full.
+    char* Reserve(size_t size);
+    // Publish the event written at the last Reserve() pointer (into the current slot)
+    void Commit(size_t size);
+
+    void Write(const void* event, size_t size);
+
+    // Hand the partly filled slot to the consumer now
+    void Flush();
+
+    // Flush, mark the end of input and unmap; with unlink the name is removed
+    // too (mapped consumers keep working)
+    void Close(bool unlink = true);
+
+    const std::string& Name() const { return name_; }
+    uint64_t MaxEventSize() const { return slotSize_; }
+    uint64_t ProducerStallNs() const { return stallNs_; }
+
+private:
+    shm_ring::Slot& SlotAt(uint32_t index);
+    char* SlotData(uint32_t index);
+    bool FindFreeSlot();
+    void AcquireSlot();
+
+    std::string name_;
+    void* base_ = nullptr;
+    size_t size_ = 0;
+    shm_ring::Header* header_ = nullptr;
+    uint32_t slotCount_ = 0;
+    uint64_t slotSize_ = 0;
+
+    uint64_t sequence_ = 0;      // sequence number of the slot being filled
+    uint32_t slot_ = 0;          // index of the slot being filled
+    bool haveSlot_ = false;
+    uint64_t fill_ = 0;          // bytes used in the slot being filled
+    uint32_t fillEvents_ = 0;
+    uint64_t fillPayload_ = 0;   // event bytes without padding
+    uint64_t stallNs_ = 0;
+};
+
+#endif // MIDAS_EVENT_UNPACKER_SHM_EVENT_RING_H
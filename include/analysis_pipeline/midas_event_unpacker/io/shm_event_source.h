@@ -0,0 +1,96 @@
+#ifndef MIDAS_EVENT_UNPACKER_SHM_EVENT_SOURCE_H
+#define MIDAS_EVENT_UNPACKER_SHM_EVENT_SOURCE_H
+
+#include "analysis_pipeline/midas_event_unpacker/io/shm_event_ring.h"
+#include "midasio.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * ShmEventSource reads MIDAS events in place from a shared-memory ring
+ * written by ShmEventRingProducer (for example the midas_ring_replay tool).
+ * Next() returns read-only TMEvent views over the ring slot, so nothing is
+ * copied between the producer and the unpacker: ByteStream and bank view
+ * products keep the event, and the event keeps its slot, which returns to
+ * the producer once the last of them is dropped.
+ *
+ *   ShmEventSource source("/midas_events");
+ *   while (auto event = source.Next()) {
+ *       InputBundle input;
+ *       input.set("TMEvent", event);
+ *       stage.SetInput(input);
+ *       stage.Process();
+ *   }
+ *
+ * One source per ring. Products that outlive many events (the last product
+ * of a bank that stopped appearing, say) hold their slots. Once views hold
+ * all but shm_ring::kFreeSlotsKept slots, the events of the next slot are
+ * copied out of the ring instead, so the producer always has slots to cycle
+ * through; Stats::copiedEvents counts them.
+ */
+class ShmEventSource {
+public:
+    struct Options {
+        uint32_t openTimeoutMs = 5000;  // wait this long for the producer to create the ring
+        size_t poolSize = 1024;         // recycled TMEvent objects
+    };
+
+    struct Stats {
+        uint64_t events = 0;
+        uint64_t slots = 0;
+        uint64_t bytes = 0;             // event bytes handed out
+        uint64_t consumerStallNs = 0;   // time Next() waited on an empty ring
+        uint64_t copiedEvents = 0;      // events copied out because views held too many slots
+    };
+
+    // Throws std::runtime_error if the ring does not appear in time or is invalid
+    explicit ShmEventSource(const std::string& name);
+    ShmEventSource(const std::string& name, const Options& options);
+    ~ShmEventSource();
+
+    ShmEventSource(const ShmEventSource&) = delete;
+    ShmEventSource& operator=(const ShmEventSource&) = delete;
+
+    // Next event; blocks while the ring is empty, nullptr once the producer
+    // closed the ring and it is drained, after Stop(), on a corrupted slot or
+    // when the producer exited without closing the ring
+    std::shared_ptr<TMEvent> Next();
+
+    // Make a blocked Next() return nullptr, callable from any thread
+    void Stop() { stop_.store(true, std::memory_order_release); }
+
+    Stats GetStats() const { return stats_; }
+
+    bool HasError() const { return !errorString_.empty(); }
+    const std::string& ErrorString() const { return errorString_; }
+
+private:
+    class Mapping;
+    class SlotLease;
+
+    shm_ring::Slot* FindReadySlot();
+    uint32_t SlotsInUse() const;
+    bool TakeSlot();
+    void Fail(const std::string& message);
+
+    std::string name_;
+    Options options_;
+    std::shared_ptr<Mapping> mapping_;
+    shm_ring::Header* header_ = nullptr;
+    TMEventPool pool_;
+
+    uint64_t sequence_ = 0;                // sequence number of the next slot to take
+    std::shared_ptr<const void> lease_;    // slot events are being handed out from
+    bool copyOut_ = false;                 // events of the leased slot are copied, not viewed
+    const char* cursor_ = nullptr;
+    const char* slotEnd_ = nullptr;
+    uint32_t remaining_ = 0;               // events left in the leased slot
+
+    std::atomic<bool> stop_{false};
+    Stats stats_;
+    std::string errorString_;
+};
+
+#endif // MIDAS_EVENT_UNPACKER_SHM_EVENT_SOURCE_H
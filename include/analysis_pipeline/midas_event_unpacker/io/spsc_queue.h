@@ -0,0 +1,69 @@
+#ifndef MIDAS_EVENT_UNPACKER_SPSC_QUEUE_H
+#define MIDAS_EVENT_UNPACKER_SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/**
+ * Bounded single-producer/single-consumer lock-free ring buffer.
+ * Exactly one thread may call TryPush and exactly one thread may call TryPop.
+ */
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) {
+        if (capacity == 0) {
+            throw std::invalid_argument("SpscQueue: capacity must be positive");
+        }
+        size_t size = 1;
+        while (size < capacity + 1) size <<= 1;  // one slot stays empty to tell full from empty
+        slots_.resize(size);
+        mask_ = size - 1;
+        capacity_ = capacity;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer side; returns false if the queue is full
+    bool TryPush(T&& value) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t head = head_.load(std::memory_order_acquire);
+        if (tail - head >= capacity_) return false;
+        slots_[tail & mask_] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; returns false if the queue is empty
+    bool TryPop(T& value) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        if (head == tail) return false;
+        value = std::move(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate number of queued elements, safe to call from any thread
+    size_t Size() const {
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        const size_t head = head_.load(std::memory_order_acquire);
+        return tail - head;
+    }
+
+    size_t Capacity() const { return capacity_; }
+
+private:
+    std::vector<T> slots_;
+    size_t mask_ = 0;
+    size_t capacity_ = 0;
+
+    alignas(64) std::atomic<size_t> head_{0};  // next slot to pop, written by the consumer
+    alignas(64) std::atomic<size_t> tail_{0};  // next slot to push, written by the producer
+};
+
+#endif // MIDAS_EVENT_UNPACKER_SPSC_QUEUE_H
@@ -0,0 +1,53 @@
+#ifndef MIDAS_EVENT_UNPACKER_BANK_SELECTION_H
+#define MIDAS_EVENT_UNPACKER_BANK_SELECTION_H
+
+#include "midasio.h"
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * BankSelection decides which events and banks a stage unpacks. It is
+ * configured from the "bank_selection" stage parameter:
+ *
+ *   "bank_selection": {
+ *       "allow": ["ADC0", "TDC0"],   // only these banks (default: all)
+ *       "deny": ["DBG0"],            // never these banks
+ *       "event_ids": [1, 2],         // only these event IDs (default: all)
+ *       "trigger_mask": 4            // only events with one of these trigger bits set (default: all)
+ *   }
+ *
+ * With an allow list, SelectBanks() looks each name up with
+ * TMEvent::FindBank(), which scans incrementally from bank_scan_position,
+ * so the scan stops at the last requested bank instead of decoding the
+ * whole event.
+ */
+class BankSelection {
+public:
+    BankSelection() = default;
+
+    static BankSelection FromJson(const nlohmann::json& config);
+
+    // True if nothing is filtered, the stage can take the FindAllBanks() path
+    bool SelectsAll() const;
+
+    bool AcceptsEvent(const TMEvent& event) const;
+    bool AcceptsBank(uint32_t fourcc) const;
+    bool AcceptsBank(const std::string& name) const { return AcceptsBank(TMFourCC(name.c_str())); }
+
+    // Accepted banks of the event in event order, found in event.banks
+    void SelectBanks(TMEvent& event, std::vector<const TMBank*>& selected) const;
+
+    // Accepted banks of the event in event order, found in the bank index
+    void SelectRecords(TMEvent& event, std::vector<const TMBankRecord*>& selected) const;
+
+private:
+    std::vector<std::string> allow_names_;
+    std::vector<uint32_t> allow_;
+    std::vector<uint32_t> deny_;
+    std::vector<uint16_t> event_ids_;
+    uint16_t trigger_mask_ = 0;  // 0 = any
+};
+
+#endif // MIDAS_EVENT_UNPACKER_BANK_SELECTION_H
@@ -0,0 +1,45 @@
+#ifndef MIDAS_EVENT_UNPACKER_EVENT_FILTER_H
+#define MIDAS_EVENT_UNPACKER_EVENT_FILTER_H
+
+#include "midasio.h"
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <vector>
+
+/**
+ * EventFilter is an event-level predicate on bank content, serial number and
+ * size, configured from the "filter" stage parameter:
+ *
+ *   "filter": {
+ *       "require_banks": ["ADC0"],       // all of these banks present
+ *       "any_banks": ["TDC0", "TDC1"],   // at least one of these banks present
+ *       "serial_range": [1000, 2000],    // first <= serial_number <= last
+ *       "min_size": 64,                  // event bytes, header included
+ *       "max_size": 1048576              // 0 = no limit
+ *   }
+ *
+ * Bank lookups go through the event's bank index (TMEvent::FindBankRecord()),
+ * which is built once and reused by later stages.
+ */
+class EventFilter {
+public:
+    EventFilter() = default;
+
+    static EventFilter FromJson(const nlohmann::json& config);
+
+    // True if every event passes
+    bool AcceptsAll() const;
+
+    bool Accepts(TMEvent& event) const;
+
+private:
+    std::vector<uint32_t> require_banks_;
+    std::vector<uint32_t> any_banks_;
+    bool has_serial_range_ = false;
+    uint32_t serial_first_ = 0;
+    uint32_t serial_last_ = 0;
+    uint64_t min_size_ = 0;
+    uint64_t max_size_ = 0;  // 0 = no limit
+};
+
+#endif // MIDAS_EVENT_UNPACKER_EVENT_FILTER_H
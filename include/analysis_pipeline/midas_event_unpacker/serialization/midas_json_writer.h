@@ -0,0 +1,32 @@
+#ifndef MIDAS_EVENT_UNPACKER_MIDAS_JSON_WRITER_H
+#define MIDAS_EVENT_UNPACKER_MIDAS_JSON_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Direct-to-buffer JSON writers for MIDAS banks. Every function appends
+ * exactly the bytes nlohmann::json::dump() produces for the same value,
+ * without building a json DOM.
+ */
+namespace midas_json {
+
+void AppendUnsigned(std::string& out, uint64_t value);
+void AppendSigned(std::string& out, int64_t value);
+void AppendDouble(std::string& out, double value);
+void AppendString(std::string& out, const char* data, size_t size);
+void AppendHexString(std::string& out, const char* data, size_t size);
+
+// True if bank data of this TID_* type is written as numbers or a string, false if as hex
+bool IsDecodedType(uint32_t type);
+
+// Bank data as a JSON array, string or hex string depending on type; null if data is null or empty
+void AppendBankData(std::string& out, uint32_t type, const char* data, size_t size);
+
+// {"data":...,"data_size":N,"name":"NAME","type":T}
+void AppendBank(std::string& out, const std::string& name, uint32_t type, const char* data, uint32_t size);
+
+} // namespace midas_json
+
+#endif // MIDAS_EVENT_UNPACKER_MIDAS_JSON_WRITER_H
@@ -0,0 +1,27 @@
+// MidasEventToBankViewStage.h
+#ifndef MIDAS_EVENT_TO_BANK_VIEW_STAGE_H
+#define MIDAS_EVENT_TO_BANK_VIEW_STAGE_H
+
+#include "analysis_pipeline/midas_event_unpacker/stages/midas_event_unpacker_stage.h"
+#include "analysis_pipeline/midas_event_unpacker/data_products/MidasBankView.h"
+#include <memory>
+
+/**
+ * MidasEventToBankViewStage publishes every selected bank of the event as a typed,
+ * read-only MidasBankView over the event memory, so consumers get numbers
+ * without a JSON or manual reinterpretation step.
+ */
+class MidasEventToBankViewStage : public MidasEventUnpackerStage {
+public:
+    MidasEventToBankViewStage();
+    ~MidasEventToBankViewStage() override;
+
+    void ProcessMidasEvent(std::shared_ptr<TMEvent> event) override;
+
+    std::string Name() const override;
+
+private:
+    ClassDefOverride(MidasEventToBankViewStage, 1);
+};
+
+#endif // MIDAS_EVENT_TO_BANK_VIEW_STAGE_H
@@ -5,8 +5,29 @@
 #include "analysis_pipeline/midas_event_unpacker/stages/midas_event_unpacker_stage.h"
 #include "analysis_pipeline/unpacker_core/data_products/ByteStream.h"
 #include "analysis_pipeline/unpacker_core/data_products/JsonProduct.h"
+#include "analysis_pipeline/midas_event_unpacker/data_products/ByteStreamBatch.h"
+#include "analysis_pipeline/midas_event_unpacker/data_products/MidasEventHeader.h"
+#include "analysis_pipeline/midas_event_unpacker/data_products/LazyMidasEvent.h"
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
+/**
+ * MidasEventToByteStreamStage publishes every selected bank as a ByteStream
+ * ("bytestream_bank_<NAME>_type_<TID>") pointing into the event, plus an
+ * event_header (or JSON event_metadata) product. Batches give one
+ * ByteStreamBatch per bank name and type instead.
+ *
+ * Product names and tags are formatted once per bank layout, and ByteStream
+ * objects are reused once downstream has dropped them; an idle ByteStream
+ * lets go of its event right after the next publish, so a bank that stops
+ * appearing does not keep its last event, file mapping or ring slot alive
+ * from inside the pool. The PipelineDataProduct wrapper of a bank, with its
+ * name and tags, is taken back from the DataProductManager on the bank's
+ * next event and published again with only the ByteStream swapped, so the
+ * steady state allocates nothing per bank.
+ */
 class MidasEventToByteStreamStage : public MidasEventUnpackerStage {
 public:
     MidasEventToByteStreamStage();
@@ -14,9 +35,43 @@ public:
 
     void ProcessMidasEvent(std::shared_ptr<TMEvent> event) override;
 
+    // One ByteStreamBatch product per bank name and type, one metadata product per batch
+    void ProcessMidasEventBatch(const std::shared_ptr<MidasEventBatch>& batch) override;
+
     std::string Name() const override;
 
+protected:
+    void OnInit() override;
+    void onProductsInvalidated() override;
+
 private:
+    // Product name and tags of one (FOURCC, type) bank, formatted once per run
+    struct BankTemplate {
+        std::string bankName;
+        std::string productName;
+        std::string batchProductName;
+        std::string typeTag;
+        std::vector<std::shared_ptr<dataProducts::ByteStream>> streams;  // reused once downstream lets go of them
+        bool published = false;  // the manager holds this bank's wrapper from an earlier event
+    };
+
+    BankTemplate& bankTemplate(const TMBank& bank);
+    // The wrapper published for entry last time, or a new one with its name and tags
+    std::unique_ptr<PipelineDataProduct> bankProduct(BankTemplate& entry);
+    // Clears data and owner of every pooled ByteStream nobody else references
+    void releaseIdleStreams();
+    void addMetadataProduct(const TMEvent& event, size_t numBanks);
+    void addBatchMetadataProduct(const MidasEventBatch& batch, const std::vector<size_t>& numBanks);
+
+    // "lazy_products": one LazyMidasEvent per event instead of a product per bank
+    void processLazy(const std::shared_ptr<TMEvent>& event);
+    void processLazyBatch(const std::shared_ptr<MidasEventBatch>& batch);
+
+    bool json_metadata_ = false;  //! "metadata_format": "binary" (default) or "json"
+    bool lazy_products_ = false;  //! "lazy_products": publish event_lazy_bytestream instead of per-bank products
+    std::unordered_map<uint64_t, BankTemplate> bank_templates_;  //!
+    std::vector<std::shared_ptr<dataProducts::MidasEventHeader>> headers_;  //! reused once downstream lets go of them
+
     ClassDefOverride(MidasEventToByteStreamStage, 1);
 };
 
@@ -4,9 +4,11 @@
 
 #include "analysis_pipeline/midas_event_unpacker/stages/midas_event_unpacker_stage.h"
 #include "analysis_pipeline/unpacker_core/data_products/JsonProduct.h"
+#include "analysis_pipeline/midas_event_unpacker/data_products/LazyMidasEvent.h"
 #include <nlohmann/json.hpp>
 #include <memory>
 #include <string>
+#include <vector>
 
 class MidasEventToJsonStage : public MidasEventUnpackerStage {
 public:
@@ -15,12 +17,37 @@ public:
 
     void ProcessMidasEvent(std::shared_ptr<TMEvent> event) override;
 
+    // One event_json_batch product holding a JSON array of the batch events
+    void ProcessMidasEventBatch(const std::shared_ptr<MidasEventBatch>& batch) override;
+
     std::string Name() const override;
 
+    // JSON of one event as it goes into event_json, with the configured
+    // serializer and bank selection
+    std::string SerializeEvent(TMEvent& event);
+
+protected:
+    void OnInit() override;
+
 private:
+    // DOM serializer: builds an nlohmann::json tree and dumps it
+    std::string serializeWithDom(const TMEvent& event, const std::vector<const TMBank*>& banks) const;
     nlohmann::json decodeBankData(const TMBank& bank, const TMEvent& event) const;
     std::string toHexString(const char* data, size_t size) const;
 
+    // Streaming serializer: writes the same bytes as dump() straight into out
+    void serializeStreaming(const TMEvent& event, const std::vector<const TMBank*>& banks, std::string& out) const;
+
+    // Moves json_buffer_ into target and re-reserves it at the size just written
+    void takeJsonBuffer(std::string& target);
+
+    // "lazy_products": bank JSON is written when a consumer asks for it
+    std::shared_ptr<dataProducts::LazyMidasEvent> makeLazyEvent(std::shared_ptr<TMEvent> event) const;
+
+    bool streaming_serializer_ = true;  //! "serializer": "streaming" (default) or "dom"
+    bool lazy_products_ = false;        //! "lazy_products": publish event_lazy_json instead of event_json
+    std::string json_buffer_;           //! output buffer of the streaming serializer, handed to the product
+
     ClassDefOverride(MidasEventToJsonStage, 1);
 };
 
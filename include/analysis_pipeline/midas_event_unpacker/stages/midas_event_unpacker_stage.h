@@ -2,13 +2,45 @@
 #define MIDAS_EVENT_UNPACKER_STAGE_H
 
 #include "analysis_pipeline/core/stages/input/base_input_stage.h"
+#include "analysis_pipeline/midas_event_unpacker/selection/bank_selection.h"
+#include "analysis_pipeline/midas_event_unpacker/instrumentation/unpacker_metrics_recorder.h"
 #include "midasio.h"
 #include <memory>
 #include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Events handed to a stage in one SetInput/Process cycle (InputBundle key "TMEventBatch")
+using MidasEventBatch = std::vector<std::shared_ptr<TMEvent>>;
 
 /**
  * MidasEventUnpackerStage provides a base class for MIDAS unpacking stages
  * that consume TMEvent via InputBundle and emit custom data products.
+ *
+ * The InputBundle carries either a single event under "TMEvent" or a
+ * MidasEventBatch under "TMEventBatch". Batches go to ProcessMidasEventBatch,
+ * which stages can override to amortize per-event product overhead.
+ *
+ * The optional "bank_selection" parameter (see BankSelection) drops events
+ * before they reach ProcessMidasEvent/ProcessMidasEventBatch; stages pick
+ * their banks with selectBanks(). When an event (or a whole batch) is
+ * dropped, every product the stage published before is replaced by an empty
+ * product tagged "invalid" and "rejected_event", so downstream stages do not
+ * take the previous event's products for current ones and the previous
+ * event is released.
+ *
+ * Process calls are timed by phase (bank scan, product build, product
+ * publishing through publish()/publishMultiple()) into latency histograms,
+ * one call in "metrics_sample_period" (default 8) to keep clock reads off
+ * most events. Event, bank and per-bank-name counters see every call. With
+ * "metrics_interval": N the snapshot is published as
+ * "unpacker_metrics_<Name()>" every N events; GetMetrics() and DumpMetrics()
+ * take one on demand. Building with MIDAS_UNPACKER_INSTRUMENTATION=0
+ * removes all of it. Lazy products are scanned and counted through
+ * selectRecords() when they are built; banks materialized later by a
+ * consumer are not timed.
  */
 class MidasEventUnpackerStage : public BaseInputStage {
 public:
@@ -21,14 +53,71 @@ public:
     // Run unpacking on the most recent input
     void Process() final override;
 
+    // Current instrumentation counters and histograms, callable from any thread
+    std::shared_ptr<dataProducts::UnpackerMetrics> GetMetrics() const;
+
+    // Logs GetMetrics() as JSON at info level
+    void DumpMetrics() const;
+
 protected:
+    // Parses "bank_selection"; stages overriding OnInit call this first
+    void OnInit() override;
+
     void SetCurrentEvent(std::shared_ptr<TMEvent> event);
+    void SetCurrentBatch(std::shared_ptr<MidasEventBatch> batch);
 
     std::shared_ptr<TMEvent> current_event_;
+    std::shared_ptr<MidasEventBatch> current_batch_; //!
+
+    // Banks of event accepted by the bank selection, valid until the next call
+    const std::vector<const TMBank*>& selectBanks(TMEvent& event);
+
+    std::shared_ptr<const BankSelection> bank_selection_; //! shared with lazy products
+    std::vector<const TMBank*> selected_banks_;           //! scratch for selectBanks()
+
+    // Same from the bank index (lazy products), timed and counted like selectBanks()
+    const std::vector<const TMBankRecord*>& selectRecords(TMEvent& event);
+    std::vector<const TMBankRecord*> selected_records_;   //! scratch for selectRecords()
+
+    // DataProductManager insertion, timed as the publish phase
+    void publish(const std::string& name, std::unique_ptr<PipelineDataProduct> product);
+    void publishMultiple(std::vector<std::pair<std::string, std::unique_ptr<PipelineDataProduct>>> products);
+
+    UnpackerMetricsRecorder metrics_;  //!
 
     // Subclasses implement MIDAS unpacking logic here
     virtual void ProcessMidasEvent(std::shared_ptr<TMEvent> event) = 0;
 
+    // Default calls ProcessMidasEvent for each event of the batch
+    virtual void ProcessMidasEventBatch(const std::shared_ptr<MidasEventBatch>& batch);
+
+    // Called after rejected input replaced the stage's products; stages that
+    // pool product objects drop what those still point into
+    virtual void onProductsInvalidated() {}
+
+private:
+    // Returns false if the bank selection rejected all input
+    bool processCurrentInput();
+    void notePublished(const std::string& name);
+    // Replaces every product published so far by an empty "invalid" one
+    void invalidateProducts();
+    void recordPhases(uint64_t startNs);
+    void publishMetricsIfDue();
+
+    // Clock read on sampled calls only
+    uint64_t timerNow() const { return timing_call_ ? UnpackerMetricsRecorder::Now() : 0; }
+
+    uint64_t metrics_interval_ = 0;       //! "metrics_interval": events between metrics products, 0 = never
+    uint64_t events_since_metrics_ = 0;   //!
+    uint64_t metrics_sample_period_ = 8;  //! "metrics_sample_period": time one Process call in N
+    uint64_t calls_ = 0;                  //!
+    bool timing_call_ = false;            //! the current Process call is timed
+    uint64_t call_scan_ns_ = 0;           //! scan time of the current Process call
+    uint64_t call_publish_ns_ = 0;        //! publish time of the current Process call
+
+    std::unordered_set<std::string> published_names_;  //! every product name publish()/publishMultiple() used
+    bool products_valid_ = false;         //! the products under published_names_ belong to accepted input
+
     ClassDefOverride(MidasEventUnpackerStage, 1);
 };
 
@@ -0,0 +1,64 @@
+#ifndef MIDAS_EVENT_WRITER_STAGE_H
+#define MIDAS_EVENT_WRITER_STAGE_H
+
+#include "analysis_pipeline/midas_event_unpacker/stages/midas_event_unpacker_stage.h"
+#include "analysis_pipeline/midas_event_unpacker/selection/event_filter.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+/**
+ * MidasEventWriterStage writes the events that pass its predicate to a MIDAS
+ * file, for skims of large runs. A ".lz4" output is one LZ4 frame of
+ * independent blocks (readable by TMNewReader and the parallel LZ4 reader),
+ * compressed on "lz4_threads" worker threads; any other name is written raw.
+ *
+ *   "output_file": "skim00042.mid.lz4",
+ *   "lz4_level": 1,            // 1-2 fast, 3-12 HC, negative trades ratio for speed
+ *   "lz4_threads": 2,          // 0 compresses on the pipeline thread
+ *   "lz4_checksum": true,      // content checksum in the frame
+ *   "filter": { ... },         // see EventFilter
+ *   "prescale": 1              // keep one event in N of those passing the filter
+ *
+ * The event-level part of "bank_selection" (event_ids, trigger_mask) applies
+ * as in every unpacker stage; events are always written whole. SetPredicate()
+ * adds a predicate from code, applied after the filter.
+ */
+class MidasEventWriterStage : public MidasEventUnpackerStage {
+public:
+    using Predicate = std::function<bool(const TMEvent&)>;
+
+    MidasEventWriterStage();
+    ~MidasEventWriterStage() override;
+
+    void ProcessMidasEvent(std::shared_ptr<TMEvent> event) override;
+
+    std::string Name() const override;
+
+    void SetPredicate(Predicate predicate);
+
+    // Flushes and closes the output; also done by the destructor. Throws
+    // std::runtime_error if the output could not be completed.
+    void Close();
+
+    uint64_t EventsWritten() const { return events_written_; }
+    uint64_t BytesWritten() const { return bytes_written_; }
+
+protected:
+    void OnInit() override;
+
+private:
+    std::string output_file_;                     //!
+    std::unique_ptr<TMWriterInterface> writer_;   //!
+    EventFilter filter_;                          //!
+    Predicate predicate_;                         //!
+    uint64_t prescale_ = 1;                       //!
+    uint64_t events_passed_ = 0;                  //!
+    uint64_t events_written_ = 0;                 //!
+    uint64_t bytes_written_ = 0;                  //!
+
+    ClassDefOverride(MidasEventWriterStage, 1);
+};
+
+#endif // MIDAS_EVENT_WRITER_STAGE_H
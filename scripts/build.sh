@@ -19,6 +19,8 @@ show_help() {
     echo "  -o, --overwrite           Remove existing build directory before building"
     echo "  -j, --jobs <number>       Specify number of processors to use (default: all available)"
     echo "  -b, --use-bundled-midas   Use bundled MIDAS instead of system MIDASSYS"
+    echo "  --benchmarks              Also build midas_unpacker_bench (needs --use-bundled-midas)"
+    echo "  --tests                   Also build the unit tests (needs --use-bundled-midas)"
     echo "  -h, --help                Display this help message"
 }
 
@@ -42,6 +44,14 @@ while [[ "$#" -gt 0 ]]; do
             EXTRA_CMAKE_ARGS+=("-DUSE_BUNDLED_MIDAS=ON")
             shift
             ;;
+        --benchmarks)
+            EXTRA_CMAKE_ARGS+=("-DBUILD_BENCHMARKS=ON")
+            shift
+            ;;
+        --tests)
+            EXTRA_CMAKE_ARGS+=("-DBUILD_TESTS=ON")
+            shift
+            ;;
         -h|--help)
             show_help
             exit 0
@@ -0,0 +1,16 @@
+#include "analysis_pipeline/midas_event_unpacker/data_products/ByteStreamBatch.h"
+
+ClassImp(dataProducts::ByteStreamBatch)
+
+namespace dataProducts {
+
+ByteStreamBatch::ByteStreamBatch() = default;
+ByteStreamBatch::~ByteStreamBatch() = default;
+
+void ByteStreamBatch::Add(const uint8_t* bankData, size_t bankSize, uint32_t serialNumber) {
+    data.push_back(bankData);
+    sizes.push_back(bankSize);
+    serialNumbers.push_back(serialNumber);
+}
+
+} // namespace dataProducts
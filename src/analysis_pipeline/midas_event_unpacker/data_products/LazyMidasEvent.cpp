@@ -0,0 +1,122 @@
+#include "analysis_pipeline/midas_event_unpacker/data_products/LazyMidasEvent.h"
+#include "analysis_pipeline/midas_event_unpacker/serialization/midas_json_writer.h"
+#include <cstring>
+
+ClassImp(dataProducts::LazyMidasEvent)
+ClassImp(dataProducts::LazyMidasEventBatch)
+
+namespace dataProducts {
+
+LazyMidasEvent::LazyMidasEvent() = default;
+LazyMidasEvent::~LazyMidasEvent() = default;
+
+void LazyMidasEvent::Assign(std::shared_ptr<TMEvent> event, std::shared_ptr<const BankSelection> selection) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    event_ = std::move(event);
+    selection_ = std::move(selection);
+    entries_.clear();
+    if (!event_) {
+        return;
+    }
+    serialNumber = event_->serial_number;
+    eventId = event_->event_id;
+    // Header scan only, so lookups below never modify the event
+    if (!event_->bank_index_valid) {
+        event_->BuildBankIndex();
+    }
+}
+
+std::vector<std::string> LazyMidasEvent::BankNames() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> names;
+    if (!event_) {
+        return names;
+    }
+    for (const auto& record : event_->bank_records) {
+        if (selection_ && !selection_->AcceptsBank(record.fourcc)) {
+            continue;
+        }
+        // FOURCC of a short name is padded with zeros
+        const char* c = reinterpret_cast<const char*>(&record.fourcc);
+        names.emplace_back(c, strnlen(c, 4));
+    }
+    return names;
+}
+
+bool LazyMidasEvent::HasBank(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return findRecord(name) != nullptr;
+}
+
+const TMBankRecord* LazyMidasEvent::findRecord(const std::string& name) const {
+    if (!event_ || name.empty() || name.size() > 4) {
+        return nullptr;
+    }
+    uint32_t fourcc = TMFourCC(name.c_str());
+    if (selection_ && !selection_->AcceptsBank(fourcc)) {
+        return nullptr;
+    }
+    return event_->FindBankRecord(fourcc);
+}
+
+LazyMidasEvent::Entry& LazyMidasEvent::entry(uint32_t fourcc) const {
+    for (auto& e : entries_) {
+        if (e.fourcc == fourcc) {
+            return e;
+        }
+    }
+    entries_.emplace_back();
+    entries_.back().fourcc = fourcc;
+    return entries_.back();
+}
+
+std::shared_ptr<const ByteStream> LazyMidasEvent::GetByteStream(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const TMBankRecord* record = findRecord(name);
+    if (!record) {
+        return nullptr;
+    }
+
+    Entry& e = entry(record->fourcc);
+    if (!e.stream) {
+        const char* bankData = static_cast<const TMEvent&>(*event_).GetBankData(record);
+        if (!bankData || record->data_size == 0) {
+            return nullptr;
+        }
+        auto stream = std::make_shared<ByteStream>();
+        stream->data = reinterpret_cast<const uint8_t*>(bankData);
+        stream->size = record->data_size;
+        stream->owner = std::static_pointer_cast<void>(event_);
+        e.stream = std::move(stream);
+    }
+    return e.stream;
+}
+
+std::shared_ptr<const std::string> LazyMidasEvent::GetBankJson(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const TMBankRecord* record = findRecord(name);
+    if (!record) {
+        return nullptr;
+    }
+
+    Entry& e = entry(record->fourcc);
+    if (!e.json) {
+        const char* bankData = static_cast<const TMEvent&>(*event_).GetBankData(record);
+        // The 4 name bytes of the event, as TMBank::name has them in event_json
+        const std::string bankName(reinterpret_cast<const char*>(&record->fourcc), 4);
+        auto json = std::make_shared<std::string>();
+        midas_json::AppendBank(*json, bankName, record->type, bankData, record->data_size);
+        e.json = std::move(json);
+    }
+    return e.json;
+}
+
+size_t LazyMidasEvent::NumMaterialized() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+LazyMidasEventBatch::LazyMidasEventBatch() = default;
+LazyMidasEventBatch::~LazyMidasEventBatch() = default;
+
+} // namespace dataProducts
@@ -0,0 +1,43 @@
+#include "analysis_pipeline/midas_event_unpacker/data_products/MidasBankView.h"
+
+ClassImp(dataProducts::MidasBankView)
+
+namespace dataProducts {
+
+MidasBankView::MidasBankView() = default;
+MidasBankView::~MidasBankView() = default;
+
+void MidasBankView::Assign(const std::string& bankName, uint32_t bankType, const char* bankData,
+                           uint32_t bankSize, std::shared_ptr<void> bankOwner) {
+    name = bankName;
+    type = bankType;
+    data = bankData;
+    dataSize = bankSize;
+    owner = std::move(bankOwner);
+
+    elementSize = ElementSize(type);
+    elementCount = dataSize / elementSize;
+    aligned = reinterpret_cast<uintptr_t>(data) % elementSize == 0;
+}
+
+size_t MidasBankView::ElementSize(uint32_t tid) {
+    switch (tid) {
+        case TID_UINT16:
+        case TID_INT16:
+            return 2;
+        case TID_UINT32:
+        case TID_INT32:
+        case TID_BOOL:
+        case TID_FLOAT:
+        case TID_BITFIELD:
+            return 4;
+        case TID_DOUBLE:
+        case TID_INT64:
+        case TID_UINT64:
+            return 8;
+        default:
+            return 1;
+    }
+}
+
+} // namespace dataProducts
@@ -0,0 +1,31 @@
+#include "analysis_pipeline/midas_event_unpacker/data_products/MidasEventHeader.h"
+
+ClassImp(dataProducts::MidasEventHeader)
+ClassImp(dataProducts::MidasEventHeaderBatch)
+
+namespace dataProducts {
+
+MidasEventHeaderRecord MidasEventHeaderRecord::FromEvent(const TMEvent& event) {
+    return FromEvent(event, static_cast<uint32_t>(event.banks.size()));
+}
+
+MidasEventHeaderRecord MidasEventHeaderRecord::FromEvent(const TMEvent& event, uint32_t numBanks) {
+    MidasEventHeaderRecord record;
+    record.eventId = event.event_id;
+    record.triggerMask = event.trigger_mask;
+    record.serialNumber = event.serial_number;
+    record.timeStamp = event.time_stamp;
+    record.dataSize = event.data_size;
+    record.eventHeaderSize = static_cast<uint32_t>(event.event_header_size);
+    record.bankHeaderFlags = event.bank_header_flags;
+    record.numBanks = numBanks;
+    return record;
+}
+
+MidasEventHeader::MidasEventHeader() = default;
+MidasEventHeader::~MidasEventHeader() = default;
+
+MidasEventHeaderBatch::MidasEventHeaderBatch() = default;
+MidasEventHeaderBatch::~MidasEventHeaderBatch() = default;
+
+} // namespace dataProducts
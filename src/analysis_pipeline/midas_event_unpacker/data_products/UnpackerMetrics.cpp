@@ -0,0 +1,45 @@
+#include "analysis_pipeline/midas_event_unpacker/data_products/UnpackerMetrics.h"
+#include <nlohmann/json.hpp>
+
+ClassImp(dataProducts::UnpackerMetrics)
+
+namespace dataProducts {
+
+UnpackerMetrics::UnpackerMetrics() = default;
+UnpackerMetrics::~UnpackerMetrics() = default;
+
+std::string UnpackerMetrics::ToJson() const {
+    nlohmann::json j;
+    j["stage"] = stageName;
+    j["enabled"] = enabled;
+    j["events"] = events;
+    j["rejected_events"] = rejectedEvents;
+    j["batches"] = batches;
+    j["event_bytes"] = eventBytes;
+    j["banks"] = banks;
+    j["bank_bytes"] = bankBytes;
+    j["products_published"] = productsPublished;
+
+    j["phases"] = nlohmann::json::object();
+    for (const auto& p : phases) {
+        nlohmann::json jp;
+        jp["count"] = p.count;
+        jp["total_ns"] = p.totalNs;
+        jp["mean_ns"] = p.count ? static_cast<double>(p.totalNs) / p.count : 0.0;
+        jp["max_ns"] = p.maxNs;
+        jp["p50_ns"] = p.p50Ns;
+        jp["p90_ns"] = p.p90Ns;
+        jp["p99_ns"] = p.p99Ns;
+        jp["bucket_upper_ns"] = p.bucketUpperNs;
+        jp["bucket_counts"] = p.bucketCounts;
+        j["phases"][p.phase] = std::move(jp);
+    }
+
+    j["bank_stats"] = nlohmann::json::object();
+    for (const auto& b : bankStats) {
+        j["bank_stats"][b.name] = {{"events", b.events}, {"banks", b.banks}, {"bytes", b.bytes}};
+    }
+    return j.dump();
+}
+
+} // namespace dataProducts
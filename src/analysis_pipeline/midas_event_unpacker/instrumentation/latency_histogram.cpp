@@ -0,0 +1,43 @@
+#include "analysis_pipeline/midas_event_unpacker/instrumentation/latency_histogram.h"
+
+uint64_t LatencyHistogram::BucketLowerBound(size_t index) {
+    if (index < kSubBuckets) {
+        return index;
+    }
+    size_t shift = (index - kSubBuckets) / kSubBuckets;
+    size_t sub = (index - kSubBuckets) % kSubBuckets;
+    return static_cast<uint64_t>(kSubBuckets + sub) << shift;
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(size_t index) {
+    if (index + 1 >= kNumBuckets) {
+        return UINT64_MAX;
+    }
+    return BucketLowerBound(index + 1) - 1;
+}
+
+uint64_t LatencyHistogram::Percentile(double q) const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+        total += BucketCount(i);
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(q * total + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > total) rank = total;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+        seen += BucketCount(i);
+        if (seen >= rank) {
+            // never report more than the largest value seen
+            uint64_t upper = BucketUpperBound(i);
+            uint64_t max = Max();
+            return upper < max || max == 0 ? upper : max;
+        }
+    }
+    return Max();
+}
@@ -0,0 +1,106 @@
+#include "analysis_pipeline/midas_event_unpacker/instrumentation/unpacker_metrics_recorder.h"
+#include <cstring>
+
+const char* UnpackerPhaseName(UnpackerPhase phase) {
+    switch (phase) {
+        case UnpackerPhase::kScan:    return "scan";
+        case UnpackerPhase::kBuild:   return "build";
+        case UnpackerPhase::kPublish: return "publish";
+        case UnpackerPhase::kTotal:   return "total";
+        default:                      return "unknown";
+    }
+}
+
+#if MIDAS_UNPACKER_INSTRUMENTATION
+
+UnpackerMetricsRecorder::BankSlot& UnpackerMetricsRecorder::slot(uint32_t fourcc) {
+    if (fourcc == 0) {
+        return overflow_;  // a zeroed bank name; 0 marks a free slot
+    }
+    unsigned h = (fourcc * 2654435761u) >> 24;  // top 8 bits of a multiplicative hash
+    for (unsigned probe = 0; probe < kBankSlots; ++probe) {
+        BankSlot& s = slots_[(h + probe) % kBankSlots];
+        uint32_t key = s.fourcc.load(std::memory_order_relaxed);
+        if (key == fourcc) {
+            return s;
+        }
+        if (key == 0) {
+            // release: a reader that sees the key also sees zeroed counters
+            s.fourcc.store(fourcc, std::memory_order_release);
+            return s;
+        }
+    }
+    return overflow_;
+}
+
+void UnpackerMetricsRecorder::CountBank(uint32_t fourcc, uint64_t bytes) {
+    bump(banks_, 1);
+    bump(bankBytes_, bytes);
+
+    BankSlot& s = slot(fourcc);
+    bump(s.banks, 1);
+    bump(s.bytes, bytes);
+    if (s.lastSeq != bankScanSeq_) {
+        s.lastSeq = bankScanSeq_;
+        bump(s.events, 1);
+    }
+}
+
+void UnpackerMetricsRecorder::Snapshot(dataProducts::UnpackerMetrics& out) const {
+    out.enabled = true;
+    out.events = events_.load(std::memory_order_relaxed);
+    out.rejectedEvents = rejectedEvents_.load(std::memory_order_relaxed);
+    out.batches = batches_.load(std::memory_order_relaxed);
+    out.eventBytes = eventBytes_.load(std::memory_order_relaxed);
+    out.banks = banks_.load(std::memory_order_relaxed);
+    out.bankBytes = bankBytes_.load(std::memory_order_relaxed);
+    out.productsPublished = products_.load(std::memory_order_relaxed);
+
+    out.phases.clear();
+    for (unsigned i = 0; i < static_cast<unsigned>(UnpackerPhase::kNumPhases); ++i) {
+        const LatencyHistogram& h = phases_[i];
+        dataProducts::UnpackerPhaseStats p;
+        p.phase = UnpackerPhaseName(static_cast<UnpackerPhase>(i));
+        p.count = h.Count();
+        p.totalNs = h.Sum();
+        p.maxNs = h.Max();
+        p.p50Ns = h.Percentile(0.50);
+        p.p90Ns = h.Percentile(0.90);
+        p.p99Ns = h.Percentile(0.99);
+        for (size_t b = 0; b < LatencyHistogram::kNumBuckets; ++b) {
+            uint64_t n = h.BucketCount(b);
+            if (n > 0) {
+                p.bucketUpperNs.push_back(LatencyHistogram::BucketUpperBound(b));
+                p.bucketCounts.push_back(n);
+            }
+        }
+        out.phases.push_back(std::move(p));
+    }
+
+    out.bankStats.clear();
+    auto addBank = [&](const BankSlot& s, const char* fallbackName) {
+        uint32_t fourcc = s.fourcc.load(std::memory_order_acquire);
+        dataProducts::UnpackerBankStats b;
+        if (fallbackName) {
+            b.name = fallbackName;
+        } else {
+            // FOURCC of a short name is padded with zeros
+            const char* c = reinterpret_cast<const char*>(&fourcc);
+            b.name.assign(c, strnlen(c, 4));
+        }
+        b.events = s.events.load(std::memory_order_relaxed);
+        b.banks = s.banks.load(std::memory_order_relaxed);
+        b.bytes = s.bytes.load(std::memory_order_relaxed);
+        if (b.banks > 0) {
+            out.bankStats.push_back(std::move(b));
+        }
+    };
+    for (const auto& s : slots_) {
+        if (s.fourcc.load(std::memory_order_acquire) != 0) {
+            addBank(s, nullptr);
+        }
+    }
+    addBank(overflow_, "????");
+}
+
+#endif // MIDAS_UNPACKER_INSTRUMENTATION
@@ -0,0 +1,225 @@
+#include "analysis_pipeline/midas_event_unpacker/io/indexed_event_reader.h"
+#include "analysis_pipeline/midas_event_unpacker/io/lz4_block_reader.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Uncompressed file reader that can be repositioned
+class SeekableFileReader : public TMReaderInterface {
+public:
+    explicit SeekableFileReader(const std::string& filename) : filename_(filename) {
+        fp_ = std::fopen(filename.c_str(), "rb");
+        if (!fp_) {
+            fError = true;
+            fErrorString = "fopen(\"" + filename + "\"): " + std::strerror(errno);
+        }
+    }
+
+    ~SeekableFileReader() override { Close(); }
+
+    int Read(void* buf, int count) override {
+        if (fError) return -1;
+        size_t rd = std::fread(buf, 1, static_cast<size_t>(count), fp_);
+        if (rd == 0 && std::ferror(fp_)) {
+            fError = true;
+            fErrorString = "fread(\"" + filename_ + "\"): " + std::strerror(errno);
+            return -1;
+        }
+        return static_cast<int>(rd);
+    }
+
+    int Close() override {
+        if (fp_) {
+            std::fclose(fp_);
+            fp_ = nullptr;
+        }
+        return 0;
+    }
+
+    bool Seek(uint64_t offset) {
+        if (fError) return false;
+        if (fseeko(fp_, static_cast<off_t>(offset), SEEK_SET) != 0) {
+            fError = true;
+            fErrorString = "fseeko(\"" + filename_ + "\"): " + std::strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::string filename_;
+    FILE* fp_ = nullptr;
+};
+
+TMReaderInterface* openReader(const std::string& filename, MidasEventIndex::Compression compression) {
+    switch (compression) {
+    case MidasEventIndex::Compression::kLz4:
+        return new Lz4BlockReader(filename);
+    case MidasEventIndex::Compression::kNone:
+        return new SeekableFileReader(filename);
+    case MidasEventIndex::Compression::kGzip:
+        break;
+    }
+    return TMNewReader(filename.c_str());
+}
+
+} // namespace
+
+IndexedEventReader::IndexedEventReader(const std::string& filename,
+                                       std::shared_ptr<const MidasEventIndex> index)
+    : filename_(filename), index_(std::move(index)) {
+    if (!index_) {
+        throw std::invalid_argument("IndexedEventReader: no index for '" + filename + "'");
+    }
+    end_ = index_->Size();
+
+    reader_.reset(openReader(filename_, index_->GetCompression()));
+    if (index_->GetCompression() == MidasEventIndex::Compression::kLz4) {
+        lz4Reader_ = static_cast<Lz4BlockReader*>(reader_.get());
+    }
+    if (reader_->fError) {
+        Fail("cannot open '" + filename_ + "': " + reader_->fErrorString);
+    }
+}
+
+IndexedEventReader::~IndexedEventReader() {
+    if (reader_) reader_->Close();
+}
+
+void IndexedEventReader::Fail(const std::string& message) {
+    if (!error_) {
+        error_ = true;
+        errorString_ = message;
+        spdlog::error("[IndexedEventReader] {}", message);
+    }
+}
+
+void IndexedEventReader::Seek(size_t entry) {
+    if (entry > index_->Size()) {
+        throw std::out_of_range("IndexedEventReader::Seek - entry " + std::to_string(entry) +
+                                " past the end of the index (" + std::to_string(index_->Size()) + " events)");
+    }
+    next_ = entry;
+}
+
+void IndexedEventReader::SetRange(const MidasEventRange& range) {
+    if (range.begin > range.end || range.end > index_->Size()) {
+        throw std::out_of_range("IndexedEventReader::SetRange - range [" + std::to_string(range.begin) + ", " +
+                                std::to_string(range.end) + ") outside the index");
+    }
+    end_ = range.end;
+    range_ = range;
+    Seek(range.begin);
+}
+
+bool IndexedEventReader::PositionAt(size_t entry) {
+    const MidasEventIndexEntry& e = (*index_)[entry];
+
+    switch (index_->GetCompression()) {
+    case MidasEventIndex::Compression::kLz4: {
+        Lz4BlockReader::Position position;
+        position.frameOffset = e.frameOffset;
+        position.blockOffset = e.blockOffset;
+        position.blockSkip = e.blockSkip;
+        if (!lz4Reader_->Seek(position)) {
+            Fail("cannot seek to event " + std::to_string(entry) + ": " + lz4Reader_->fErrorString);
+            return false;
+        }
+        break;
+    }
+    case MidasEventIndex::Compression::kNone:
+        if (!static_cast<SeekableFileReader*>(reader_.get())->Seek(e.offset)) {
+            Fail("cannot seek to event " + std::to_string(entry) + ": " + reader_->fErrorString);
+            return false;
+        }
+        break;
+    case MidasEventIndex::Compression::kGzip: {
+        // no random access into a deflate stream: reopen when going backwards, then decode forward
+        if (e.offset < streamOffset_) {
+            reader_->Close();
+            reader_.reset(TMNewReader(filename_.c_str()));
+            streamOffset_ = 0;
+            if (reader_->fError) {
+                Fail("cannot reopen '" + filename_ + "': " + reader_->fErrorString);
+                return false;
+            }
+        }
+        std::vector<char> scratch(64 * 1024);
+        while (streamOffset_ < e.offset) {
+            int want = static_cast<int>(std::min<uint64_t>(scratch.size(), e.offset - streamOffset_));
+            int rd = reader_->Read(scratch.data(), want);
+            if (rd <= 0) {
+                Fail("cannot skip to event " + std::to_string(entry) + " in '" + filename_ + "'");
+                return false;
+            }
+            streamOffset_ += static_cast<uint64_t>(rd);
+        }
+        break;
+    }
+    }
+
+    positioned_ = entry;
+    return true;
+}
+
+std::shared_ptr<TMEvent> IndexedEventReader::ReadNext() {
+    if (error_) {
+        return nullptr;
+    }
+    if (positioned_ != next_ && !PositionAt(next_)) {
+        return nullptr;
+    }
+
+    const MidasEventIndexEntry& entry = (*index_)[next_];
+    auto event = pool_.ReadEvent(reader_.get());
+    if (!event || event->error) {
+        Fail("cannot read event " + std::to_string(next_) + " (serial " + std::to_string(entry.serialNumber) +
+             ") from '" + filename_ + "'" + (reader_->fError ? ": " + reader_->fErrorString : std::string()));
+        return nullptr;
+    }
+    if (event->serial_number != entry.serialNumber || event->event_id != entry.eventId ||
+        event->event_header_size + event->data_size != entry.size) {
+        Fail("event " + std::to_string(next_) + " of '" + filename_ + "' does not match the index "
+             "(serial " + std::to_string(event->serial_number) + ", expected " +
+             std::to_string(entry.serialNumber) + "); rebuild the index");
+        return nullptr;
+    }
+
+    streamOffset_ = entry.offset + entry.size;
+    positioned_ = ++next_;
+    return event;
+}
+
+std::shared_ptr<TMEvent> IndexedEventReader::Next() {
+    // skipped entries are not decoded, ReadNext() seeks past them
+    while (next_ < end_ && !range_.Contains((*index_)[next_])) {
+        ++next_;
+    }
+    if (next_ >= end_) {
+        return nullptr;
+    }
+    return ReadNext();
+}
+
+std::shared_ptr<TMEvent> IndexedEventReader::ReadAt(size_t entry) {
+    Seek(entry);
+    if (entry == index_->Size()) {
+        return nullptr;
+    }
+    return ReadNext();
+}
+
+std::shared_ptr<TMEvent> IndexedEventReader::ReadSerial(uint32_t serialNumber) {
+    size_t entry = index_->FindSerial(serialNumber);
+    if (entry == index_->Size()) {
+        return nullptr;
+    }
+    return ReadAt(entry);
+}
@@ -0,0 +1,307 @@
+#include "analysis_pipeline/midas_event_unpacker/io/lz4_block_reader.h"
+#include "mlz4.h"
+#include "mxxhash.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace {
+
+constexpr uint32_t kFrameMagic = 0x184D2204;
+constexpr uint32_t kSkippableMagicMask = 0xFFFFFFF0;
+constexpr uint32_t kSkippableMagic = 0x184D2A50;
+constexpr uint32_t kUncompressedBit = 0x80000000;
+constexpr size_t kHistorySize = 64 * 1024;
+
+uint32_t readLE32(const void* p) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+} // namespace
+
+Lz4BlockReader::Lz4BlockReader(const std::string& filename) : filename_(filename) {
+    fp_ = std::fopen(filename.c_str(), "rb");
+    if (!fp_) {
+        Fail(std::string("fopen: ") + std::strerror(errno));
+    }
+}
+
+Lz4BlockReader::~Lz4BlockReader() {
+    Close();
+}
+
+int Lz4BlockReader::Close() {
+    if (fp_) {
+        std::fclose(fp_);
+        fp_ = nullptr;
+    }
+    return 0;
+}
+
+void Lz4BlockReader::Fail(const std::string& message) {
+    if (!fError) {
+        fError = true;
+        fErrorString = filename_ + ": " + message;
+    }
+}
+
+bool Lz4BlockReader::ReadFully(void* buf, size_t count, const char* what) {
+    size_t rd = std::fread(buf, 1, count, fp_);
+    fileOffset_ += rd;
+    if (rd != count) {
+        Fail(std::string(std::ferror(fp_) ? "read error in " : "truncated ") + what +
+             " at offset " + std::to_string(fileOffset_));
+        return false;
+    }
+    return true;
+}
+
+bool Lz4BlockReader::SeekFile(uint64_t offset) {
+    if (fseeko(fp_, static_cast<off_t>(offset), SEEK_SET) != 0) {
+        Fail("cannot seek to offset " + std::to_string(offset) + ": " + std::strerror(errno));
+        return false;
+    }
+    fileOffset_ = offset;
+    return true;
+}
+
+// Reads the next frame header, skipping skippable frames. False at a clean
+// end of file (fError unset) or on error.
+bool Lz4BlockReader::ReadFrameHeader() {
+    while (true) {
+        uint64_t start = fileOffset_;
+        unsigned char magic[4];
+        size_t rd = std::fread(magic, 1, 4, fp_);
+        fileOffset_ += rd;
+        if (rd == 0 && !std::ferror(fp_)) {
+            return false;
+        }
+        if (rd != 4) {
+            Fail("truncated LZ4 frame magic at offset " + std::to_string(start));
+            return false;
+        }
+
+        uint32_t m = readLE32(magic);
+        if ((m & kSkippableMagicMask) == kSkippableMagic) {
+            unsigned char size[4];
+            if (!ReadFully(size, 4, "LZ4 skippable frame")) return false;
+            if (!SeekFile(fileOffset_ + readLE32(size))) return false;
+            continue;
+        }
+        if (m != kFrameMagic) {
+            Fail("invalid LZ4 frame magic at offset " + std::to_string(start));
+            return false;
+        }
+
+        unsigned char desc[2 + 8 + 4 + 1];
+        if (!ReadFully(desc, 2, "LZ4 frame header")) return false;
+
+        unsigned flg = desc[0];
+        unsigned bd = desc[1];
+        if ((flg >> 6) != 1) {
+            Fail("unsupported LZ4 frame version " + std::to_string(flg >> 6));
+            return false;
+        }
+        unsigned bsid = (bd >> 4) & 7;
+        if (bsid < 4) {
+            Fail("invalid LZ4 block size id " + std::to_string(bsid));
+            return false;
+        }
+
+        size_t more = ((flg & 0x08) ? 8 : 0) + ((flg & 0x01) ? 4 : 0) + 1;
+        if (!ReadFully(desc + 2, more, "LZ4 frame header")) return false;
+        if (((XXH32(desc, 2 + more - 1, 0) >> 8) & 0xFF) != desc[2 + more - 1]) {
+            Fail("LZ4 frame header checksum mismatch at offset " + std::to_string(start));
+            return false;
+        }
+        if (flg & 0x01) {
+            Fail("LZ4 frames with a dictionary id are not supported");
+            return false;
+        }
+
+        inFrame_ = true;
+        frameOffset_ = start;
+        frameFirstBlock_ = fileOffset_;
+        frameDecoded_ = 0;
+        blockIndependent_ = flg & 0x20;
+        blockChecksum_ = flg & 0x10;
+        contentChecksum_ = flg & 0x04;
+        contentHashed_ = contentChecksum_;
+        XXH32_reset(&contentHash_, 0);
+        blockMaxSize_ = size_t(1) << (8 + 2 * bsid);
+        history_.clear();
+        return true;
+    }
+}
+
+// Decodes the next non-empty block into block_, crossing frame boundaries.
+// False at end of file (fError unset) or on error.
+bool Lz4BlockReader::ReadBlock() {
+    if (!fp_ || fError) return false;
+
+    while (true) {
+        if (!inFrame_ && !ReadFrameHeader()) {
+            return false;
+        }
+
+        uint64_t start = fileOffset_;
+        unsigned char word[4];
+        if (!ReadFully(word, 4, "LZ4 block size")) return false;
+        uint32_t size = readLE32(word);
+
+        if (size == 0) {  // end mark
+            if (contentChecksum_) {
+                unsigned char sum[4];
+                if (!ReadFully(sum, 4, "LZ4 content checksum")) return false;
+                if (contentHashed_ && XXH32_digest(&contentHash_) != readLE32(sum)) {
+                    Fail("LZ4 content checksum mismatch in the frame at offset " + std::to_string(frameOffset_));
+                    return false;
+                }
+            }
+            inFrame_ = false;
+            continue;
+        }
+
+        bool uncompressed = size & kUncompressedBit;
+        size &= ~kUncompressedBit;
+        if (size > blockMaxSize_) {
+            Fail("LZ4 block of " + std::to_string(size) + " bytes at offset " +
+                 std::to_string(start) + " exceeds the frame block size");
+            return false;
+        }
+
+        src_.resize(size);
+        if (!ReadFully(src_.data(), size, "LZ4 block")) return false;
+        if (blockChecksum_) {
+            unsigned char sum[4];
+            if (!ReadFully(sum, 4, "LZ4 block checksum")) return false;
+            if (XXH32(src_.data(), size, 0) != readLE32(sum)) {
+                Fail("LZ4 block checksum mismatch at offset " + std::to_string(start));
+                return false;
+            }
+        }
+
+        block_.resize(blockMaxSize_);
+        int n;
+        if (uncompressed) {
+            std::memcpy(block_.data(), src_.data(), size);
+            n = static_cast<int>(size);
+        } else if (blockIndependent_ || history_.empty()) {
+            n = MLZ4_decompress_safe(src_.data(), block_.data(), static_cast<int>(size),
+                                     static_cast<int>(blockMaxSize_));
+        } else {
+            n = MLZ4_decompress_safe_usingDict(src_.data(), block_.data(), static_cast<int>(size),
+                                               static_cast<int>(blockMaxSize_), history_.data(),
+                                               static_cast<int>(history_.size()));
+        }
+        if (n < 0) {
+            Fail("corrupted LZ4 block at offset " + std::to_string(start));
+            return false;
+        }
+        if (contentHashed_) {
+            XXH32_update(&contentHash_, block_.data(), static_cast<size_t>(n));
+        }
+
+        if (!blockIndependent_) {
+            size_t count = static_cast<size_t>(n);
+            if (count >= kHistorySize) {
+                history_.assign(block_.data() + count - kHistorySize, block_.data() + count);
+            } else {
+                history_.insert(history_.end(), block_.data(), block_.data() + count);
+                if (history_.size() > kHistorySize) {
+                    history_.erase(history_.begin(), history_.end() - kHistorySize);
+                }
+            }
+        }
+
+        blockOffset_ = start;
+        blockSize_ = static_cast<size_t>(n);
+        blockPos_ = 0;
+        if (blockSize_ > 0) {
+            return true;
+        }
+    }
+}
+
+int Lz4BlockReader::Read(void* buf, int count) {
+    char* out = static_cast<char*>(buf);
+    int done = 0;
+    while (done < count) {
+        if (blockPos_ == blockSize_ && !ReadBlock()) {
+            break;
+        }
+        size_t n = std::min(blockSize_ - blockPos_, static_cast<size_t>(count - done));
+        std::memcpy(out + done, block_.data() + blockPos_, n);
+        blockPos_ += n;
+        done += static_cast<int>(n);
+        decodedOffset_ += n;
+        frameDecoded_ += n;
+    }
+    if (done == 0 && fError) {
+        return -1;
+    }
+    return done;
+}
+
+uint64_t Lz4BlockReader::Skip(uint64_t count) {
+    uint64_t done = 0;
+    while (done < count) {
+        if (blockPos_ == blockSize_ && !ReadBlock()) {
+            break;
+        }
+        size_t n = static_cast<size_t>(std::min<uint64_t>(blockSize_ - blockPos_, count - done));
+        blockPos_ += n;
+        done += n;
+        decodedOffset_ += n;
+        frameDecoded_ += n;
+    }
+    return done;
+}
+
+bool Lz4BlockReader::Tell(Position* position) {
+    if (blockPos_ == blockSize_ && !ReadBlock()) {
+        return false;
+    }
+    position->frameOffset = frameOffset_;
+    if (blockIndependent_) {
+        position->blockOffset = blockOffset_;
+        position->blockSkip = blockPos_;
+    } else {
+        position->blockOffset = frameFirstBlock_;
+        position->blockSkip = frameDecoded_;
+    }
+    return true;
+}
+
+bool Lz4BlockReader::Seek(const Position& position) {
+    if (!fp_ || fError) return false;
+
+    inFrame_ = false;
+    blockSize_ = 0;
+    blockPos_ = 0;
+    decodedOffset_ = 0;
+
+    if (!SeekFile(position.frameOffset)) return false;
+    if (!ReadFrameHeader() || frameOffset_ != position.frameOffset) {
+        Fail("no LZ4 frame header at offset " + std::to_string(position.frameOffset));
+        return false;
+    }
+    if (!blockIndependent_ && position.blockOffset != frameFirstBlock_) {
+        Fail("linked-block LZ4 frame at offset " + std::to_string(position.frameOffset) +
+             " can only be entered at its first block");
+        return false;
+    }
+    if (position.blockOffset != frameFirstBlock_) {
+        contentHashed_ = false;  // the blocks before are never decoded
+    }
+    if (!SeekFile(position.blockOffset)) return false;
+
+    if (Skip(position.blockSkip) != position.blockSkip) {
+        Fail("LZ4 position past the end of the frame at offset " + std::to_string(position.frameOffset));
+        return false;
+    }
+    decodedOffset_ = 0;
+    return true;
+}
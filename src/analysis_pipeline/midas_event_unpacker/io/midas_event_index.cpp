@@ -0,0 +1,331 @@
+#include "analysis_pipeline/midas_event_unpacker/io/midas_event_index.h"
+#include "analysis_pipeline/midas_event_unpacker/io/lz4_block_reader.h"
+#include "midasio.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char kMagic[8] = {'M', 'I', 'D', 'A', 'S', 'I', 'D', 'X'};
+
+struct IndexFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t compression;
+    uint64_t sourceSize;
+    int64_t sourceMtimeNs;
+    uint64_t numEntries;
+    uint32_t entrySize;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(IndexFileHeader) == 48, "IndexFileHeader is an on-disk record");
+
+bool endsWith(const std::string& s, const char* suffix) {
+    size_t n = std::strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+bool statFile(const std::string& filename, uint64_t* size, int64_t* mtimeNs, std::string* error) {
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) {
+        *error = "cannot stat '" + filename + "': " + std::strerror(errno);
+        return false;
+    }
+    *size = static_cast<uint64_t>(st.st_size);
+    *mtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+MidasEventIndexEntry makeEntry(const TMEvent& event, uint64_t offset) {
+    MidasEventIndexEntry entry;
+    entry.offset = offset;
+    entry.serialNumber = event.serial_number;
+    entry.timeStamp = event.time_stamp;
+    entry.size = event.event_header_size + event.data_size;
+    entry.eventId = event.event_id;
+    entry.triggerMask = event.trigger_mask;
+    return entry;
+}
+
+void checkEvent(const TMEvent& event, uint64_t offset, const std::string& filename) {
+    if (event.error) {
+        throw std::runtime_error("MidasEventIndex: truncated or corrupted event at decoded offset " +
+                                 std::to_string(offset) + " in '" + filename + "'");
+    }
+}
+
+} // namespace
+
+std::string MidasEventIndex::DefaultPath(const std::string& filename) {
+    return filename + ".idx";
+}
+
+MidasEventIndex::Compression MidasEventIndex::CompressionFor(const std::string& filename) {
+    if (endsWith(filename, ".lz4")) return Compression::kLz4;
+    if (endsWith(filename, ".gz")) return Compression::kGzip;
+    if (endsWith(filename, ".bz2")) {
+        throw std::runtime_error("MidasEventIndex: bzip2 files cannot be indexed: '" + filename + "'");
+    }
+    return Compression::kNone;
+}
+
+void MidasEventIndex::Append(const MidasEventIndexEntry& entry) {
+    if (!entries_.empty() && entry.serialNumber < entries_.back().serialNumber) {
+        serialsSorted_ = false;
+    }
+    entries_.push_back(entry);
+}
+
+MidasEventIndex MidasEventIndex::Build(const std::string& filename) {
+    MidasEventIndex index;
+    index.filename_ = filename;
+    index.compression_ = CompressionFor(filename);
+
+    std::string error;
+    if (!statFile(filename, &index.sourceSize_, &index.sourceMtimeNs_, &error)) {
+        throw std::runtime_error("MidasEventIndex: " + error);
+    }
+
+    TMEvent event;
+
+    if (index.compression_ == Compression::kLz4) {
+        Lz4BlockReader reader(filename);
+        while (!reader.fError) {
+            Lz4BlockReader::Position position;
+            if (!reader.Tell(&position)) break;
+            uint64_t offset = reader.DecodedOffset();
+            if (!TMReadEvent(&reader, &event)) break;
+            checkEvent(event, offset, filename);
+
+            MidasEventIndexEntry entry = makeEntry(event, offset);
+            entry.frameOffset = position.frameOffset;
+            entry.blockOffset = position.blockOffset;
+            entry.blockSkip = position.blockSkip;
+            index.Append(entry);
+        }
+        if (reader.fError) {
+            throw std::runtime_error("MidasEventIndex: " + reader.fErrorString);
+        }
+    } else {
+        std::unique_ptr<TMReaderInterface> reader(TMNewReader(filename.c_str()));
+        uint64_t offset = 0;
+        while (!reader->fError && TMReadEvent(reader.get(), &event)) {
+            checkEvent(event, offset, filename);
+            MidasEventIndexEntry entry = makeEntry(event, offset);
+            index.Append(entry);
+            offset += entry.size;
+        }
+        bool failed = reader->fError;
+        std::string readError = reader->fErrorString;
+        reader->Close();
+        if (failed) {
+            throw std::runtime_error("MidasEventIndex: cannot read '" + filename + "': " + readError);
+        }
+    }
+
+    return index;
+}
+
+bool MidasEventIndex::Load(const std::string& filename, const std::string& indexPath,
+                           MidasEventIndex* index, std::string* error) {
+    uint64_t sourceSize = 0;
+    int64_t sourceMtimeNs = 0;
+    if (!statFile(filename, &sourceSize, &sourceMtimeNs, error)) {
+        return false;
+    }
+
+    uint64_t indexSize = 0;
+    int64_t indexMtimeNs = 0;
+    if (!statFile(indexPath, &indexSize, &indexMtimeNs, error)) {
+        return false;
+    }
+
+    std::unique_ptr<FILE, int (*)(FILE*)> fp(std::fopen(indexPath.c_str(), "rb"), &std::fclose);
+    if (!fp) {
+        *error = "cannot open '" + indexPath + "': " + std::strerror(errno);
+        return false;
+    }
+
+    IndexFileHeader header;
+    if (std::fread(&header, sizeof(header), 1, fp.get()) != 1 ||
+        std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        *error = "'" + indexPath + "' is not a MIDAS event index";
+        return false;
+    }
+    if (header.version != kVersion || header.entrySize != sizeof(MidasEventIndexEntry)) {
+        *error = "'" + indexPath + "' has index version " + std::to_string(header.version) +
+                 ", expected " + std::to_string(kVersion);
+        return false;
+    }
+    if (header.compression != static_cast<uint32_t>(CompressionFor(filename))) {
+        *error = "'" + indexPath + "' was built for a different compression";
+        return false;
+    }
+    if (header.sourceSize != sourceSize || header.sourceMtimeNs != sourceMtimeNs) {
+        *error = "'" + indexPath + "' is stale, '" + filename + "' changed since it was built";
+        return false;
+    }
+    if (indexSize != sizeof(header) + header.numEntries * sizeof(MidasEventIndexEntry)) {
+        *error = "'" + indexPath + "' is truncated";
+        return false;
+    }
+
+    MidasEventIndex loaded;
+    loaded.filename_ = filename;
+    loaded.compression_ = static_cast<Compression>(header.compression);
+    loaded.sourceSize_ = sourceSize;
+    loaded.sourceMtimeNs_ = sourceMtimeNs;
+    loaded.entries_.resize(header.numEntries);
+    if (header.numEntries > 0 &&
+        std::fread(loaded.entries_.data(), sizeof(MidasEventIndexEntry), header.numEntries, fp.get()) !=
+            header.numEntries) {
+        *error = "read error on '" + indexPath + "'";
+        return false;
+    }
+    loaded.serialsSorted_ = std::is_sorted(
+        loaded.entries_.begin(), loaded.entries_.end(),
+        [](const MidasEventIndexEntry& a, const MidasEventIndexEntry& b) { return a.serialNumber < b.serialNumber; });
+
+    *index = std::move(loaded);
+    return true;
+}
+
+bool MidasEventIndex::Save(const std::string& indexPath, std::string* error) const {
+    std::string tmpPath = indexPath + ".tmp." + std::to_string(getpid());
+
+    FILE* fp = std::fopen(tmpPath.c_str(), "wb");
+    if (!fp) {
+        *error = "cannot create '" + tmpPath + "': " + std::strerror(errno);
+        return false;
+    }
+
+    IndexFileHeader header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.compression = static_cast<uint32_t>(compression_);
+    header.sourceSize = sourceSize_;
+    header.sourceMtimeNs = sourceMtimeNs_;
+    header.numEntries = entries_.size();
+    header.entrySize = sizeof(MidasEventIndexEntry);
+    header.reserved = 0;
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, fp) == 1;
+    if (ok && !entries_.empty()) {
+        ok = std::fwrite(entries_.data(), sizeof(MidasEventIndexEntry), entries_.size(), fp) == entries_.size();
+    }
+    ok = (std::fclose(fp) == 0) && ok;
+
+    if (!ok || std::rename(tmpPath.c_str(), indexPath.c_str()) != 0) {
+        *error = "cannot write '" + indexPath + "': " + std::strerror(errno);
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+MidasEventIndex MidasEventIndex::LoadOrBuild(const std::string& filename, const std::string& indexPath) {
+    std::string path = indexPath.empty() ? DefaultPath(filename) : indexPath;
+
+    MidasEventIndex index;
+    std::string error;
+    if (Load(filename, path, &index, &error)) {
+        spdlog::debug("[MidasEventIndex] loaded {} events from '{}'", index.Size(), path);
+        return index;
+    }
+    spdlog::info("[MidasEventIndex] indexing '{}' ({})", filename, error);
+
+    index = Build(filename);
+    if (index.Save(path, &error)) {
+        spdlog::info("[MidasEventIndex] saved {} events to '{}'", index.Size(), path);
+    } else {
+        spdlog::warn("[MidasEventIndex] index not saved: {}", error);
+    }
+    return index;
+}
+
+uint64_t MidasEventIndex::Bytes() const {
+    return entries_.empty() ? 0 : entries_.back().offset + entries_.back().size;
+}
+
+size_t MidasEventIndex::FindSerial(uint32_t serialNumber) const {
+    MidasEventRange range = SerialRange(serialNumber, serialNumber);
+    return range.Empty() ? entries_.size() : range.begin;
+}
+
+MidasEventRange MidasEventIndex::SerialRange(uint32_t first, uint32_t last) const {
+    size_t begin = entries_.size();
+    size_t end = entries_.size();
+
+    if (serialsSorted_) {
+        auto lower = std::lower_bound(entries_.begin(), entries_.end(), first,
+            [](const MidasEventIndexEntry& e, uint32_t serial) { return e.serialNumber < serial; });
+        auto upper = std::upper_bound(lower, entries_.end(), last,
+            [](uint32_t serial, const MidasEventIndexEntry& e) { return serial < e.serialNumber; });
+        begin = lower - entries_.begin();
+        end = upper - entries_.begin();
+    } else {
+        // spans the first to the last matching event; events in between may not
+        // match and are filtered on the serials the range carries
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            uint32_t serial = entries_[i].serialNumber;
+            if (serial >= first && serial <= last) {
+                if (begin == entries_.size()) begin = i;
+                end = i + 1;
+            }
+        }
+    }
+
+    if (begin >= end) {
+        return Range(entries_.size(), entries_.size());
+    }
+    MidasEventRange range = Range(begin, end);
+    range.serialFiltered = true;
+    range.firstSerial = first;
+    range.lastSerial = last;
+    return range;
+}
+
+MidasEventRange MidasEventIndex::Range(size_t begin, size_t end) const {
+    end = std::min(end, entries_.size());
+    begin = std::min(begin, end);
+
+    MidasEventRange range;
+    range.begin = begin;
+    range.end = end;
+    if (begin < end) {
+        range.bytes = entries_[end - 1].offset + entries_[end - 1].size - entries_[begin].offset;
+    }
+    return range;
+}
+
+std::vector<MidasEventRange> MidasEventIndex::Shards(size_t n) const {
+    std::vector<MidasEventRange> shards;
+    if (entries_.empty()) {
+        return shards;
+    }
+    n = std::max<size_t>(1, std::min(n, entries_.size()));
+
+    uint64_t total = Bytes();
+    size_t begin = 0;
+    for (size_t k = 1; k <= n && begin < entries_.size(); ++k) {
+        size_t end = entries_.size();
+        if (k < n) {
+            // first event that starts at or after k/n of the stream, at least one event per shard
+            uint64_t boundary = total / n * k + total % n * k / n;
+            auto it = std::lower_bound(entries_.begin() + begin + 1, entries_.end(), boundary,
+                [](const MidasEventIndexEntry& e, uint64_t offset) { return e.offset < offset; });
+            end = it - entries_.begin();
+        }
+        shards.push_back(Range(begin, end));
+        begin = end;
+    }
+    return shards;
+}
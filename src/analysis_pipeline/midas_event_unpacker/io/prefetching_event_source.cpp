@@ -0,0 +1,195 @@
+#include "analysis_pipeline/midas_event_unpacker/io/prefetching_event_source.h"
+#include <spdlog/spdlog.h>
+#include <chrono>
+#include <stdexcept>
+
+namespace {
+
+uint64_t elapsedNs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+// Spin briefly, then yield, then sleep: cheap when the other side is close
+// behind, and does not burn a core when it is far behind.
+void backoff(unsigned& attempt) {
+    if (attempt < 64) {
+        // busy wait
+    } else if (attempt < 128) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    ++attempt;
+}
+
+} // namespace
+
+PrefetchingEventSource::PrefetchingEventSource(const std::string& filename)
+    : PrefetchingEventSource(filename, Options()) {}
+
+PrefetchingEventSource::PrefetchingEventSource(const std::string& filename, const Options& options)
+    : filename_(filename), options_(options), queue_(options.queueDepth) {}
+
+PrefetchingEventSource::~PrefetchingEventSource() {
+    Stop();
+}
+
+void PrefetchingEventSource::Start() {
+    // done_, the error, the stats and the queue all describe the one pass over the file
+    if (started_) {
+        throw std::logic_error("PrefetchingEventSource::Start - already started; use a new source to read '" +
+                               filename_ + "' again");
+    }
+    started_ = true;
+    producer_ = std::thread(&PrefetchingEventSource::Produce, this);
+}
+
+void PrefetchingEventSource::Stop() {
+    stop_.store(true, std::memory_order_release);
+    if (producer_.joinable()) {
+        producer_.join();
+
+        Stats stats = GetStats();
+        spdlog::debug("[PrefetchingEventSource] '{}': produced={} consumed={} producer_stall={}ms "
+                      "consumer_stall={}ms mean_occupancy={:.1f}/{}",
+                      filename_, stats.eventsProduced, stats.eventsConsumed,
+                      stats.producerStallNs / 1000000, stats.consumerStallNs / 1000000,
+                      stats.meanOccupancy, stats.queueDepth);
+    }
+}
+
+void PrefetchingEventSource::Fail(const std::string& message) {
+    errorString_ = message;
+    error_.store(true, std::memory_order_release);
+    spdlog::error("[PrefetchingEventSource] {}", message);
+}
+
+std::string PrefetchingEventSource::ErrorString() const {
+    return HasError() ? errorString_ : std::string();
+}
+
+std::shared_ptr<TMEvent> PrefetchingEventSource::ReadOne(TMReaderInterface* reader,
+                                                         TMMmapReader* mmapReader,
+                                                         TMEventPool& pool) {
+    if (mmapReader) {
+        auto event = mmapReader->ReadEvent();
+        if (!event && mmapReader->fError) {
+            Fail("read error on '" + filename_ + "': " + mmapReader->fErrorString);
+        }
+        return event;
+    }
+    auto event = pool.ReadEvent(reader);
+    if (!event && reader->fError) {
+        Fail("read error on '" + filename_ + "': " + reader->fErrorString);
+    }
+    return event;
+}
+
+void PrefetchingEventSource::Produce() {
+    std::unique_ptr<TMMmapReader> mmapReader;
+    std::unique_ptr<TMReaderInterface> reader;
+
+    if (options_.useMmap && TMCanMmap(filename_.c_str())) {
+        mmapReader = std::make_unique<TMMmapReader>(filename_.c_str());
+        if (mmapReader->fError) {
+            Fail("cannot open '" + filename_ + "': " + mmapReader->fErrorString);
+            done_.store(true, std::memory_order_release);
+            return;
+        }
+    } else {
+        reader.reset(TMNewReader(filename_.c_str()));
+        if (reader->fError) {
+            Fail("cannot open '" + filename_ + "': " + reader->fErrorString);
+            done_.store(true, std::memory_order_release);
+            return;
+        }
+    }
+
+    TMEventPool pool(options_.poolSize ? options_.poolSize : 2 * options_.queueDepth);
+
+    while (!stop_.load(std::memory_order_acquire)) {
+        [[maybe_unused]] uint64_t startNs = UnpackerMetricsRecorder::Now();
+        auto event = ReadOne(reader.get(), mmapReader.get(), pool);
+        if (!event) {
+            break;  // end of file or read error
+        }
+        if (event->error) {
+            Fail("corrupted or truncated event after serial " + std::to_string(event->serial_number) +
+                 " in '" + filename_ + "'");
+            break;
+        }
+#if MIDAS_UNPACKER_INSTRUMENTATION
+        uint64_t readNs = UnpackerMetricsRecorder::Now();
+        readLatency_.Record(readNs - startNs);
+        startNs = readNs;
+#endif
+        if (options_.findAllBanks) {
+            event->FindAllBanks();
+#if MIDAS_UNPACKER_INSTRUMENTATION
+            scanLatency_.Record(UnpackerMetricsRecorder::Now() - startNs);
+#endif
+        }
+
+        if (!queue_.TryPush(std::move(event))) {
+            auto start = std::chrono::steady_clock::now();
+            unsigned attempt = 0;
+            while (!queue_.TryPush(std::move(event))) {
+                if (stop_.load(std::memory_order_acquire)) break;
+                backoff(attempt);
+            }
+            producerStallNs_.fetch_add(elapsedNs(start), std::memory_order_relaxed);
+            if (event) break;  // stopped while the queue was full
+        }
+        produced_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (reader) reader->Close();
+    if (mmapReader) mmapReader->Close();
+
+    done_.store(true, std::memory_order_release);
+}
+
+std::shared_ptr<TMEvent> PrefetchingEventSource::Next() {
+    std::shared_ptr<TMEvent> event;
+
+    if (!queue_.TryPop(event)) {
+        auto start = std::chrono::steady_clock::now();
+        unsigned attempt = 0;
+        while (!queue_.TryPop(event)) {
+            // done_ is set after the last push, so check it before the final pop attempt
+            if (done_.load(std::memory_order_acquire)) {
+                queue_.TryPop(event);
+                break;
+            }
+            if (!producer_.joinable()) break;  // never started
+            backoff(attempt);
+        }
+        consumerStallNs_.fetch_add(elapsedNs(start), std::memory_order_relaxed);
+        if (!event) return nullptr;
+    }
+
+    size_t occupancy = queue_.Size() + 1;
+    occupancySum_.fetch_add(occupancy, std::memory_order_relaxed);
+    if (occupancy > maxOccupancy_.load(std::memory_order_relaxed)) {
+        maxOccupancy_.store(occupancy, std::memory_order_relaxed);
+    }
+    consumed_.fetch_add(1, std::memory_order_relaxed);
+
+    return event;
+}
+
+PrefetchingEventSource::Stats PrefetchingEventSource::GetStats() const {
+    Stats stats;
+    stats.eventsProduced = produced_.load(std::memory_order_relaxed);
+    stats.eventsConsumed = consumed_.load(std::memory_order_relaxed);
+    stats.producerStallNs = producerStallNs_.load(std::memory_order_relaxed);
+    stats.consumerStallNs = consumerStallNs_.load(std::memory_order_relaxed);
+    stats.occupancy = queue_.Size();
+    stats.maxOccupancy = maxOccupancy_.load(std::memory_order_relaxed);
+    stats.meanOccupancy = stats.eventsConsumed
+        ? static_cast<double>(occupancySum_.load(std::memory_order_relaxed)) / stats.eventsConsumed
+        : 0.0;
+    stats.queueDepth = queue_.Capacity();
+    return stats;
+}
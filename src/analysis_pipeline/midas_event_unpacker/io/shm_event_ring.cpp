@@ -0,0 +1,178 @@
+#include "analysis_pipeline/midas_event_unpacker/io/shm_event_ring.h"
+#include <spdlog/spdlog.h>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace shm_ring;
+
+ShmEventRingProducer::ShmEventRingProducer(const std::string& name, uint32_t slotCount, uint64_t slotSize)
+    : name_(name), slotCount_(slotCount), slotSize_(PaddedEventSize(slotSize)) {
+    if (name.size() < 2 || name[0] != '/' || name.find('/', 1) != std::string::npos) {
+        throw std::runtime_error("ShmEventRingProducer: ring name '" + name + "' must look like '/name'");
+    }
+    if (slotCount < 2 || slotSize_ < 64) {
+        throw std::runtime_error("ShmEventRingProducer: need at least 2 slots of 64 bytes");
+    }
+
+    shm_unlink(name.c_str());  // stale segment of an earlier run
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        throw std::runtime_error("ShmEventRingProducer: shm_open('" + name + "'): " + std::strerror(errno));
+    }
+
+    size_ = SegmentSize(slotCount_, slotSize_);
+    if (ftruncate(fd, static_cast<off_t>(size_)) != 0) {
+        int err = errno;
+        close(fd);
+        shm_unlink(name.c_str());
+        throw std::runtime_error("ShmEventRingProducer: cannot size '" + name + "' to " + std::to_string(size_) +
+                                 " bytes: " + std::strerror(err));
+    }
+
+    base_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    close(fd);
+    if (base_ == MAP_FAILED) {
+        base_ = nullptr;
+        shm_unlink(name.c_str());
+        throw std::runtime_error("ShmEventRingProducer: mmap('" + name + "'): " + std::strerror(err));
+    }
+
+    header_ = new (base_) Header();
+    header_->version = kVersion;
+    header_->slotCount = slotCount_;
+    header_->slotSize = slotSize_;
+    header_->dataOffset = DataOffset(slotCount_);
+    header_->producerPid.store(getpid(), std::memory_order_relaxed);
+    header_->consumerPid.store(0, std::memory_order_relaxed);
+    char* table = static_cast<char*>(base_) + SlotTableOffset();
+    for (uint32_t i = 0; i < slotCount_; ++i) {
+        Slot* s = new (table + i * sizeof(Slot)) Slot();
+        s->state.store(kFree, std::memory_order_relaxed);
+    }
+    header_->magic.store(kMagic, std::memory_order_release);
+
+    spdlog::debug("[ShmEventRingProducer] created '{}': {} slots of {} bytes", name_, slotCount_, slotSize_);
+}
+
+ShmEventRingProducer::~ShmEventRingProducer() {
+    Close();
+}
+
+Slot& ShmEventRingProducer::SlotAt(uint32_t index) {
+    char* table = static_cast<char*>(base_) + SlotTableOffset();
+    return *reinterpret_cast<Slot*>(table + index * sizeof(Slot));
+}
+
+char* ShmEventRingProducer::SlotData(uint32_t index) {
+    return static_cast<char*>(base_) + header_->dataOffset + index * slotSize_;
+}
+
+// Any free slot, searched from the one after the last filled: slots held
+// downstream are skipped instead of waited on
+bool ShmEventRingProducer::FindFreeSlot() {
+    for (uint32_t i = 1; i <= slotCount_; ++i) {
+        uint32_t index = (slot_ + i) % slotCount_;
+        if (SlotAt(index).state.load(std::memory_order_acquire) == kFree) {
+            slot_ = index;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ShmEventRingProducer::AcquireSlot() {
+    if (!FindFreeSlot()) {
+        // every slot is waiting for the consumer or held by its products
+        auto start = std::chrono::steady_clock::now();
+        unsigned attempt = 0;
+        while (!FindFreeSlot()) {
+            if (attempt % kLivenessCheckPeriod == kLivenessCheckPeriod - 1 &&
+                !ProcessAlive(header_->consumerPid.load(std::memory_order_acquire))) {
+                throw std::runtime_error("ShmEventRingProducer: the consumer of ring '" + name_ +
+                                         "' exited with every slot in use");
+            }
+            Backoff(attempt);
+        }
+        stallNs_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+    haveSlot_ = true;
+    fill_ = 0;
+    fillEvents_ = 0;
+    fillPayload_ = 0;
+}
+
+char* ShmEventRingProducer::Reserve(size_t size) {
+    if (!base_) {
+        throw std::runtime_error("ShmEventRingProducer: ring '" + name_ + "' is closed");
+    }
+    size_t padded = PaddedEventSize(size);
+    if (padded > slotSize_) {
+        throw std::length_error("ShmEventRingProducer: event of " + std::to_string(size) +
+                                " bytes does not fit in a " + std::to_string(slotSize_) + " byte slot");
+    }
+    if (haveSlot_ && fill_ + padded > slotSize_) {
+        Flush();
+    }
+    if (!haveSlot_) {
+        AcquireSlot();
+    }
+    return SlotData(slot_) + fill_;
+}
+
+void ShmEventRingProducer::Commit(size_t size) {
+    fill_ += PaddedEventSize(size);
+    fillPayload_ += size;
+    ++fillEvents_;
+    if (slotSize_ - fill_ < kEventAlign * 3) {
+        Flush();  // no room left for even an empty event
+    }
+}
+
+void ShmEventRingProducer::Write(const void* event, size_t size) {
+    std::memcpy(Reserve(size), event, size);
+    Commit(size);
+}
+
+void ShmEventRingProducer::Flush() {
+    if (!haveSlot_ || fillEvents_ == 0) {
+        return;
+    }
+    Slot& s = SlotAt(slot_);
+    s.numEvents = fillEvents_;
+    s.bytes = fill_;
+    s.sequence = sequence_;
+    s.state.store(kReady, std::memory_order_release);
+
+    header_->slotsPublished.fetch_add(1, std::memory_order_relaxed);
+    header_->eventsPublished.fetch_add(fillEvents_, std::memory_order_relaxed);
+    header_->bytesPublished.fetch_add(fillPayload_, std::memory_order_relaxed);
+
+    ++sequence_;
+    haveSlot_ = false;
+}
+
+void ShmEventRingProducer::Close(bool unlink) {
+    if (!base_) {
+        return;
+    }
+    Flush();
+    header_->producerDone.store(1, std::memory_order_release);
+
+    spdlog::debug("[ShmEventRingProducer] closed '{}': {} events in {} slots, producer_stall={}ms", name_,
+                  header_->eventsPublished.load(std::memory_order_relaxed),
+                  header_->slotsPublished.load(std::memory_order_relaxed), stallNs_ / 1000000);
+
+    munmap(base_, size_);
+    base_ = nullptr;
+    header_ = nullptr;
+    if (unlink) {
+        shm_unlink(name_.c_str());
+    }
+}
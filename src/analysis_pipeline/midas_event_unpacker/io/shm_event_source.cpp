@@ -0,0 +1,220 @@
+#include "analysis_pipeline/midas_event_unpacker/io/shm_event_source.h"
+#include <spdlog/spdlog.h>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace shm_ring;
+
+// The consumer's mapping of the segment, unmapped when the source and the
+// last slot lease are gone
+class ShmEventSource::Mapping {
+public:
+    Mapping(void* base, size_t size) : base_(base), size_(size) {}
+    ~Mapping() { munmap(base_, size_); }
+
+    char* Base() const { return static_cast<char*>(base_); }
+
+private:
+    void* base_;
+    size_t size_;
+};
+
+// Owner of every event view into one slot; hands the slot back to the producer
+class ShmEventSource::SlotLease {
+public:
+    SlotLease(std::shared_ptr<Mapping> mapping, Slot* slot) : mapping_(std::move(mapping)), slot_(slot) {}
+    ~SlotLease() { slot_->state.store(kFree, std::memory_order_release); }
+
+private:
+    std::shared_ptr<Mapping> mapping_;
+    Slot* slot_;
+};
+
+ShmEventSource::ShmEventSource(const std::string& name) : ShmEventSource(name, Options()) {}
+
+ShmEventSource::ShmEventSource(const std::string& name, const Options& options)
+    : name_(name), options_(options), pool_(options.poolSize) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options_.openTimeoutMs);
+
+    // wait for the producer to create the segment and finish initializing it
+    std::string error;
+    while (true) {
+        int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd >= 0) {
+            struct stat st;
+            void* base = MAP_FAILED;
+            if (fstat(fd, &st) != 0) {
+                error = std::strerror(errno);
+            } else if (static_cast<size_t>(st.st_size) < sizeof(Header)) {
+                error = "not initialized";  // the producer has not sized it yet
+            } else {
+                base = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                error = std::strerror(errno);
+            }
+            close(fd);
+            if (base != MAP_FAILED) {
+                auto mapping = std::make_shared<Mapping>(base, st.st_size);
+                auto* header = static_cast<Header*>(base);
+                if (header->magic.load(std::memory_order_acquire) == kMagic) {
+                    if (header->version != kVersion) {
+                        throw std::runtime_error("ShmEventSource: ring '" + name + "' has version " +
+                                                 std::to_string(header->version) + ", expected " +
+                                                 std::to_string(kVersion));
+                    }
+                    if (SegmentSize(header->slotCount, header->slotSize) != static_cast<size_t>(st.st_size)) {
+                        throw std::runtime_error("ShmEventSource: ring '" + name + "' has an inconsistent size");
+                    }
+                    mapping_ = std::move(mapping);
+                    header_ = header;
+                    break;
+                }
+                error = "not initialized";
+            }
+        } else {
+            error = std::strerror(errno);
+        }
+
+        if (std::chrono::steady_clock::now() >= deadline) {
+            throw std::runtime_error("ShmEventSource: cannot attach to ring '" + name + "': " + error);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    header_->consumers.fetch_add(1, std::memory_order_relaxed);
+    header_->consumerPid.store(getpid(), std::memory_order_release);
+    spdlog::debug("[ShmEventSource] attached to '{}': {} slots of {} bytes", name_, header_->slotCount,
+                  header_->slotSize);
+}
+
+ShmEventSource::~ShmEventSource() {
+    lease_.reset();
+    header_->consumerPid.store(0, std::memory_order_release);
+    header_->consumers.fetch_sub(1, std::memory_order_relaxed);
+    spdlog::debug("[ShmEventSource] '{}': events={} slots={} bytes={} copied={} consumer_stall={}ms", name_,
+                  stats_.events, stats_.slots, stats_.bytes, stats_.copiedEvents,
+                  stats_.consumerStallNs / 1000000);
+}
+
+void ShmEventSource::Fail(const std::string& message) {
+    errorString_ = message;
+    spdlog::error("[ShmEventSource] {}", message);
+}
+
+// The producer fills whichever slot is free, so the next slot is found by
+// its sequence number
+Slot* ShmEventSource::FindReadySlot() {
+    Slot* table = reinterpret_cast<Slot*>(mapping_->Base() + SlotTableOffset());
+    for (uint32_t i = 0; i < header_->slotCount; ++i) {
+        if (table[i].state.load(std::memory_order_acquire) == kReady && table[i].sequence == sequence_) {
+            return &table[i];
+        }
+    }
+    return nullptr;
+}
+
+uint32_t ShmEventSource::SlotsInUse() const {
+    const Slot* table = reinterpret_cast<const Slot*>(mapping_->Base() + SlotTableOffset());
+    uint32_t inUse = 0;
+    for (uint32_t i = 0; i < header_->slotCount; ++i) {
+        if (table[i].state.load(std::memory_order_relaxed) == kInUse) ++inUse;
+    }
+    return inUse;
+}
+
+bool ShmEventSource::TakeSlot() {
+    lease_.reset();
+    if (HasError()) {
+        return false;
+    }
+
+    Slot* slot = FindReadySlot();
+    if (!slot) {
+        auto start = std::chrono::steady_clock::now();
+        unsigned attempt = 0;
+        while (!(slot = FindReadySlot())) {
+            if (stop_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            // producerDone is stored after the last slot, so look for it once more
+            if (header_->producerDone.load(std::memory_order_acquire)) {
+                if (!(slot = FindReadySlot())) return false;
+                break;
+            }
+            if (attempt % kLivenessCheckPeriod == kLivenessCheckPeriod - 1 &&
+                !ProcessAlive(header_->producerPid.load(std::memory_order_relaxed))) {
+                if ((slot = FindReadySlot())) break;
+                Fail("the producer of ring '" + name_ + "' exited without closing it");
+                return false;
+            }
+            Backoff(attempt);
+        }
+        stats_.consumerStallNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+
+    if (slot->bytes > header_->slotSize || slot->numEvents == 0) {
+        Fail("corrupted slot " + std::to_string(sequence_) + " in ring '" + name_ + "'");
+        return false;
+    }
+
+    // views may hold at most slotCount - kFreeSlotsKept slots, this one included
+    copyOut_ = SlotsInUse() + kFreeSlotsKept >= header_->slotCount;
+
+    slot->state.store(kInUse, std::memory_order_relaxed);
+    lease_ = std::make_shared<SlotLease>(mapping_, slot);
+
+    uint32_t index = static_cast<uint32_t>(slot - reinterpret_cast<Slot*>(mapping_->Base() + SlotTableOffset()));
+    cursor_ = mapping_->Base() + header_->dataOffset + index * header_->slotSize;
+    slotEnd_ = cursor_ + slot->bytes;
+    remaining_ = slot->numEvents;
+    ++sequence_;
+    ++stats_.slots;
+    return true;
+}
+
+std::shared_ptr<TMEvent> ShmEventSource::Next() {
+    if (HasError()) {
+        return nullptr;
+    }
+    if (remaining_ == 0 && !TakeSlot()) {
+        return nullptr;
+    }
+
+    // event header: id, mask, serial, time stamp, data size
+    const size_t headerSize = 16;
+    uint32_t dataSize = 0;
+    if (slotEnd_ - cursor_ < static_cast<ptrdiff_t>(headerSize)) {
+        Fail("truncated event header in ring '" + name_ + "'");
+        return nullptr;
+    }
+    std::memcpy(&dataSize, cursor_ + 12, sizeof(dataSize));
+    size_t size = headerSize + dataSize;
+    if (static_cast<size_t>(slotEnd_ - cursor_) < size) {
+        Fail("event of " + std::to_string(size) + " bytes overruns its slot in ring '" + name_ + "'");
+        return nullptr;
+    }
+
+    auto event = pool_.NewEvent();
+    if (copyOut_) {
+        event->Reset();
+        event->data.assign(cursor_, cursor_ + size);
+        event->ParseEvent();
+        ++stats_.copiedEvents;
+    } else {
+        event->InitView(cursor_, size, lease_);
+    }
+    cursor_ += PaddedEventSize(size);
+    ++stats_.events;
+    stats_.bytes += size;
+
+    if (--remaining_ == 0) {
+        lease_.reset();  // the events of the slot own it now, or it is free again if they were copied
+    }
+    return event;
+}
@@ -0,0 +1,104 @@
+#include "analysis_pipeline/midas_event_unpacker/selection/bank_selection.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+bool contains(const std::vector<uint32_t>& list, uint32_t fourcc) {
+    return std::find(list.begin(), list.end(), fourcc) != list.end();
+}
+
+std::vector<std::string> bankNames(const nlohmann::json& config, const char* key) {
+    std::vector<std::string> names;
+    if (!config.contains(key)) {
+        return names;
+    }
+    for (const auto& name : config.at(key)) {
+        std::string s = name.get<std::string>();
+        if (s.empty() || s.size() > 4) {
+            throw std::runtime_error(std::string("BankSelection: invalid bank name '") + s + "' in '" + key +
+                                     "', expected 1 to 4 characters");
+        }
+        names.push_back(std::move(s));
+    }
+    return names;
+}
+
+} // namespace
+
+BankSelection BankSelection::FromJson(const nlohmann::json& config) {
+    if (!config.is_object()) {
+        throw std::runtime_error("BankSelection: bank_selection must be an object");
+    }
+
+    BankSelection selection;
+    selection.allow_names_ = bankNames(config, "allow");
+    for (const auto& name : selection.allow_names_) {
+        selection.allow_.push_back(TMFourCC(name.c_str()));
+    }
+    for (const auto& name : bankNames(config, "deny")) {
+        selection.deny_.push_back(TMFourCC(name.c_str()));
+    }
+    if (config.contains("event_ids")) {
+        selection.event_ids_ = config.at("event_ids").get<std::vector<uint16_t>>();
+    }
+    selection.trigger_mask_ = config.value("trigger_mask", uint16_t(0));
+    return selection;
+}
+
+bool BankSelection::SelectsAll() const {
+    return allow_.empty() && deny_.empty() && event_ids_.empty() && trigger_mask_ == 0;
+}
+
+bool BankSelection::AcceptsEvent(const TMEvent& event) const {
+    if (!event_ids_.empty() &&
+        std::find(event_ids_.begin(), event_ids_.end(), event.event_id) == event_ids_.end()) {
+        return false;
+    }
+    if (trigger_mask_ != 0 && (event.trigger_mask & trigger_mask_) == 0) {
+        return false;
+    }
+    return true;
+}
+
+bool BankSelection::AcceptsBank(uint32_t fourcc) const {
+    if (!allow_.empty() && !contains(allow_, fourcc)) {
+        return false;
+    }
+    return !contains(deny_, fourcc);
+}
+
+void BankSelection::SelectBanks(TMEvent& event, std::vector<const TMBank*>& selected) const {
+    selected.clear();
+
+    if (allow_.empty()) {
+        event.FindAllBanks();
+    } else {
+        // FindBank() resumes the scan where the previous lookup stopped, so
+        // after the last of these the rest of the event is never decoded
+        for (const auto& name : allow_names_) {
+            event.FindBank(name.c_str());
+        }
+    }
+
+    // event.banks also holds banks scanned past on the way, and repeats
+    for (const auto& bank : event.banks) {
+        if (AcceptsBank(bank.name)) {
+            selected.push_back(&bank);
+        }
+    }
+}
+
+void BankSelection::SelectRecords(TMEvent& event, std::vector<const TMBankRecord*>& selected) const {
+    selected.clear();
+
+    if (!event.bank_index_valid) {
+        event.BuildBankIndex();
+    }
+
+    for (const auto& record : event.bank_records) {
+        if (AcceptsBank(record.fourcc)) {
+            selected.push_back(&record);
+        }
+    }
+}
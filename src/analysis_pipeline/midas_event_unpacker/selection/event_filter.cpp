@@ -0,0 +1,77 @@
+#include "analysis_pipeline/midas_event_unpacker/selection/event_filter.h"
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+std::vector<uint32_t> bankFourccs(const nlohmann::json& config, const char* key) {
+    std::vector<uint32_t> fourccs;
+    if (!config.contains(key)) {
+        return fourccs;
+    }
+    for (const auto& name : config.at(key)) {
+        std::string s = name.get<std::string>();
+        if (s.empty() || s.size() > 4) {
+            throw std::runtime_error(std::string("EventFilter: invalid bank name '") + s + "' in '" + key +
+                                     "', expected 1 to 4 characters");
+        }
+        fourccs.push_back(TMFourCC(s.c_str()));
+    }
+    return fourccs;
+}
+
+} // namespace
+
+EventFilter EventFilter::FromJson(const nlohmann::json& config) {
+    if (!config.is_object()) {
+        throw std::runtime_error("EventFilter: filter must be an object");
+    }
+
+    EventFilter filter;
+    filter.require_banks_ = bankFourccs(config, "require_banks");
+    filter.any_banks_ = bankFourccs(config, "any_banks");
+    if (config.contains("serial_range")) {
+        const auto& range = config.at("serial_range");
+        if (!range.is_array() || range.size() != 2) {
+            throw std::runtime_error("EventFilter: serial_range must be [first, last]");
+        }
+        filter.has_serial_range_ = true;
+        filter.serial_first_ = range.at(0).get<uint32_t>();
+        filter.serial_last_ = range.at(1).get<uint32_t>();
+    }
+    filter.min_size_ = config.value("min_size", uint64_t(0));
+    filter.max_size_ = config.value("max_size", uint64_t(0));
+    return filter;
+}
+
+bool EventFilter::AcceptsAll() const {
+    return require_banks_.empty() && any_banks_.empty() && !has_serial_range_ && min_size_ == 0 && max_size_ == 0;
+}
+
+bool EventFilter::Accepts(TMEvent& event) const {
+    if (has_serial_range_ && (event.serial_number < serial_first_ || event.serial_number > serial_last_)) {
+        return false;
+    }
+    const uint64_t size = event.EventSize();
+    if (size < min_size_ || (max_size_ != 0 && size > max_size_)) {
+        return false;
+    }
+    for (uint32_t fourcc : require_banks_) {
+        if (!event.FindBankRecord(fourcc)) {
+            return false;
+        }
+    }
+    if (!any_banks_.empty()) {
+        bool found = false;
+        for (uint32_t fourcc : any_banks_) {
+            if (event.FindBankRecord(fourcc)) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
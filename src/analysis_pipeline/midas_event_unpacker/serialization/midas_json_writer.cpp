@@ -0,0 +1,149 @@
+#include "analysis_pipeline/midas_event_unpacker/serialization/midas_json_writer.h"
+#include "midasio.h"
+#include <nlohmann/json.hpp>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+// AppendDouble() calls nlohmann::detail::to_chars(), the Grisu2 formatter
+// behind dump(). It is internal to nlohmann::json, so the versions it has been
+// checked against are pinned here; after a bump, re-run
+// test_midas_json_serializer (which compares against dump() for millions of
+// doubles) before widening the range.
+static_assert(NLOHMANN_JSON_VERSION_MAJOR == 3 && NLOHMANN_JSON_VERSION_MINOR >= 9 &&
+                  NLOHMANN_JSON_VERSION_MINOR <= 11,
+              "midas_json::AppendDouble() relies on nlohmann::detail::to_chars(), check it against this version");
+
+namespace midas_json {
+
+namespace {
+
+template <typename T>
+void appendNumber(std::string& out, T value) {
+    if constexpr (std::is_floating_point_v<T>) {
+        AppendDouble(out, static_cast<double>(value));
+    } else if constexpr (std::is_signed_v<T>) {
+        AppendSigned(out, value);
+    } else {
+        AppendUnsigned(out, value);
+    }
+}
+
+template <typename T>
+void appendArray(std::string& out, const char* data, size_t size) {
+    const size_t count = size / sizeof(T);
+    // worst case: sign, 20 digits and a comma per element
+    out.reserve(out.size() + count * 22 + 2);
+    out.push_back('[');
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0) out.push_back(',');
+        T value;
+        std::memcpy(&value, data + i * sizeof(T), sizeof(T));
+        appendNumber(out, value);
+    }
+    out.push_back(']');
+}
+
+} // namespace
+
+void AppendUnsigned(std::string& out, uint64_t value) {
+    char buf[24];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr - buf);
+}
+
+void AppendSigned(std::string& out, int64_t value) {
+    char buf[24];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr - buf);
+}
+
+void AppendDouble(std::string& out, double value) {
+    if (!std::isfinite(value)) {
+        out.append("null", 4);
+        return;
+    }
+    // Same Grisu2 formatting nlohmann::json uses in dump(), see the version check above
+    char buf[64];
+    char* end = nlohmann::detail::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, end - buf);
+}
+
+void AppendString(std::string& out, const char* data, size_t size) {
+    // Printable ASCII needs no escaping; anything else goes through
+    // nlohmann::json so escaping and UTF-8 checks stay identical.
+    for (size_t i = 0; i < size; ++i) {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (c < 0x20 || c > 0x7E || c == '"' || c == '\\') {
+            out += nlohmann::json(std::string(data, size)).dump();
+            return;
+        }
+    }
+    out.push_back('"');
+    out.append(data, size);
+    out.push_back('"');
+}
+
+void AppendHexString(std::string& out, const char* data, size_t size) {
+    static const char digits[] = "0123456789abcdef";
+    out.reserve(out.size() + 2 * size + 2);
+    out.push_back('"');
+    for (size_t i = 0; i < size; ++i) {
+        uint8_t byte = static_cast<uint8_t>(data[i]);
+        out.push_back(digits[byte >> 4]);
+        out.push_back(digits[byte & 0x0F]);
+    }
+    out.push_back('"');
+}
+
+bool IsDecodedType(uint32_t type) {
+    switch (type) {
+        case TID_UINT8: case TID_INT8:
+        case TID_UINT16: case TID_INT16:
+        case TID_UINT32: case TID_INT32:
+        case TID_UINT64: case TID_INT64:
+        case TID_FLOAT: case TID_DOUBLE:
+        case TID_STRING:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void AppendBankData(std::string& out, uint32_t type, const char* data, size_t size) {
+    if (!data || size == 0) {
+        out.append("null", 4);
+        return;
+    }
+
+    switch (type) {
+        case TID_UINT8:  appendArray<uint8_t>(out, data, size); break;
+        case TID_INT8:   appendArray<int8_t>(out, data, size); break;
+        case TID_UINT16: appendArray<uint16_t>(out, data, size); break;
+        case TID_INT16:  appendArray<int16_t>(out, data, size); break;
+        case TID_UINT32: appendArray<uint32_t>(out, data, size); break;
+        case TID_INT32:  appendArray<int32_t>(out, data, size); break;
+        case TID_UINT64: appendArray<uint64_t>(out, data, size); break;
+        case TID_INT64:  appendArray<int64_t>(out, data, size); break;
+        case TID_FLOAT:  appendArray<float>(out, data, size); break;
+        case TID_DOUBLE: appendArray<double>(out, data, size); break;
+        case TID_STRING: AppendString(out, data, size); break;
+        default:         AppendHexString(out, data, size); break;
+    }
+}
+
+void AppendBank(std::string& out, const std::string& name, uint32_t type, const char* data, uint32_t size) {
+    // nlohmann::json objects keep their keys sorted
+    out.append("{\"data\":");
+    AppendBankData(out, type, data, size);
+    out.append(",\"data_size\":");
+    AppendUnsigned(out, size);
+    out.append(",\"name\":");
+    AppendString(out, name.data(), name.size());
+    out.append(",\"type\":");
+    AppendUnsigned(out, type);
+    out.push_back('}');
+}
+
+} // namespace midas_json
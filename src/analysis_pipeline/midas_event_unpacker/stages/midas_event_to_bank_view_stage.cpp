@@ -0,0 +1,79 @@
+#include "analysis_pipeline/midas_event_unpacker/stages/midas_event_to_bank_view_stage.h"
+#include <spdlog/spdlog.h>
+#include <memory>
+
+ClassImp(MidasEventToBankViewStage)
+
+MidasEventToBankViewStage::MidasEventToBankViewStage() {
+    spdlog::debug("[{}] Constructor called", Name());
+}
+
+MidasEventToBankViewStage::~MidasEventToBankViewStage() {
+    spdlog::debug("[{}] Destructor called", Name());
+}
+
+void MidasEventToBankViewStage::ProcessMidasEvent(std::shared_ptr<TMEvent> event) {
+    if (!event) {
+        spdlog::error("[{}] ProcessMidasEvent called with null event", Name());
+        return;
+    }
+
+    const auto& banks = selectBanks(*event);
+    if (banks.empty()) {
+        if (bank_selection_->SelectsAll()) {
+            spdlog::warn("[{}] No banks found in event", Name());
+        } else {
+            spdlog::debug("[{}] No selected banks in event {}", Name(), event->serial_number);
+        }
+        return;
+    }
+
+    const TMEvent& constEvent = *event;
+
+    std::vector<std::pair<std::string, std::unique_ptr<PipelineDataProduct>>> products;
+    products.reserve(banks.size());
+
+    for (const TMBank* selected : banks) {
+        const TMBank& bank = *selected;
+        const char* rawBankData = constEvent.GetBankData(&bank);
+        if (!rawBankData || bank.data_size == 0) {
+            spdlog::warn("[{}] Bank '{}' has null or zero-size data, skipping", Name(), bank.name);
+            continue;
+        }
+
+        auto view = std::make_shared<dataProducts::MidasBankView>();
+        view->Assign(bank.name, bank.type, rawBankData, bank.data_size,
+                     std::static_pointer_cast<void>(event));
+
+        if (bank.data_size % view->elementSize != 0) {
+            spdlog::warn("[{}] Bank '{}' size {} is not a multiple of element size {}, trailing bytes ignored",
+                         Name(), bank.name, bank.data_size, view->elementSize);
+        }
+        if (!view->aligned) {
+            spdlog::debug("[{}] Bank '{}' data is not aligned for its element type", Name(), bank.name);
+        }
+
+        std::string productName = "bank_view_" + bank.name;
+
+        auto product = std::make_unique<PipelineDataProduct>();
+        product->setName(productName);
+        product->setSharedObject(view);
+        product->addTag("unpacked_data");
+        product->addTag("built_by_midas_event_to_bank_view_stage");
+        product->addTag("bank");
+        product->addTag(bank.name);
+        product->addTag("type_" + std::to_string(bank.type));
+
+        products.emplace_back(productName, std::move(product));
+    }
+
+    if (!products.empty()) {
+        publishMultiple(std::move(products));
+    } else {
+        spdlog::warn("[{}] No valid bank view products created", Name());
+    }
+}
+
+std::string MidasEventToBankViewStage::Name() const {
+    return "MidasEventToBankViewStage";
+}
@@ -1,9 +1,51 @@
 #include "analysis_pipeline/midas_event_unpacker/stages/midas_event_to_byte_stream_stage.h"
 #include <spdlog/spdlog.h>
 #include <memory>
+#include <unordered_map>
 
 ClassImp(MidasEventToByteStreamStage)
 
+namespace {
+
+// Products are replaced in the DataProductManager on every event, so a
+// couple of objects per product are enough to always find a free one.
+constexpr size_t kMaxReusedObjects = 4;
+
+// Returns an object from pool that nobody outside the pool references,
+// or a new one (kept in the pool while there is room).
+template <typename T>
+std::shared_ptr<T> acquireReusable(std::vector<std::shared_ptr<T>>& pool) {
+    for (const auto& object : pool) {
+        if (object.use_count() == 1) {
+            return object;
+        }
+    }
+    auto object = std::make_shared<T>();
+    if (pool.size() < kMaxReusedObjects) {
+        pool.push_back(object);
+    }
+    return object;
+}
+
+uint64_t bankKey(const TMBank& bank) {
+    return (static_cast<uint64_t>(TMFourCC(bank.name.c_str())) << 32) | bank.type;
+}
+
+nlohmann::json metadataJson(const TMEvent& event, size_t numBanks) {
+    nlohmann::json jmeta;
+    jmeta["event_id"] = event.event_id;
+    jmeta["serial_number"] = event.serial_number;
+    jmeta["trigger_mask"] = event.trigger_mask;
+    jmeta["timestamp"] = event.time_stamp;
+    jmeta["data_size"] = event.data_size;
+    jmeta["event_header_size"] = event.event_header_size;
+    jmeta["bank_header_flags"] = event.bank_header_flags;
+    jmeta["num_banks"] = numBanks;
+    return jmeta;
+}
+
+} // namespace
+
 MidasEventToByteStreamStage::MidasEventToByteStreamStage() {
     spdlog::debug("[{}] Constructor called", Name());
 }
@@ -12,83 +54,355 @@ MidasEventToByteStreamStage::~MidasEventToByteStreamStage() {
     spdlog::debug("[{}] Destructor called", Name());
 }
 
-void MidasEventToByteStreamStage::ProcessMidasEvent(std::shared_ptr<TMEvent> event) {
-    if (!event) {
-        spdlog::error("[{}] ProcessMidasEvent called with null event", Name());
-        return;
+void MidasEventToByteStreamStage::OnInit() {
+    MidasEventUnpackerStage::OnInit();
+
+    lazy_products_ = parameters_.value("lazy_products", false);
+
+    std::string format = parameters_.value("metadata_format", std::string("binary"));
+    if (format == "binary") {
+        json_metadata_ = false;
+    } else if (format == "json") {
+        json_metadata_ = true;
+    } else {
+        throw std::runtime_error("MidasEventToByteStreamStage: unknown metadata_format '" + format +
+                                 "', expected 'binary' or 'json'");
     }
+    spdlog::debug("[{}] Using {} event metadata{}", Name(), format, lazy_products_ ? ", lazy products" : "");
+}
 
-    event->FindAllBanks();
-    if (event->banks.empty()) {
-        spdlog::warn("[{}] No banks found in event", Name());
-        return;
+MidasEventToByteStreamStage::BankTemplate& MidasEventToByteStreamStage::bankTemplate(const TMBank& bank) {
+    auto it = bank_templates_.find(bankKey(bank));
+    if (it != bank_templates_.end()) {
+        return it->second;
     }
 
-    // --- Add event metadata product ---
-    {
-        nlohmann::json jmeta;
-        jmeta["event_id"] = event->event_id;
-        jmeta["serial_number"] = event->serial_number;
-        jmeta["trigger_mask"] = event->trigger_mask;
-        jmeta["timestamp"] = event->time_stamp;
-        jmeta["data_size"] = event->data_size;
-        jmeta["event_header_size"] = event->event_header_size;
-        jmeta["bank_header_flags"] = event->bank_header_flags;
-        jmeta["num_banks"] = event->banks.size();
+    BankTemplate entry;
+    entry.bankName = bank.name;
+    entry.productName = "bytestream_bank_" + bank.name + "_type_" + std::to_string(bank.type);
+    entry.batchProductName = "bytestream_batch_bank_" + bank.name + "_type_" + std::to_string(bank.type);
+    entry.typeTag = "type_" + std::to_string(bank.type);
+
+    spdlog::debug("[{}] New bank layout '{}' type {}", Name(), bank.name, bank.type);
+
+    return bank_templates_.emplace(bankKey(bank), std::move(entry)).first->second;
+}
+
+std::unique_ptr<PipelineDataProduct> MidasEventToByteStreamStage::bankProduct(BankTemplate& entry) {
+    if (entry.published) {
+        entry.published = false;
+        auto product = getDataProductManager()->extractProduct(entry.productName);
+        if (product) {
+            return product;
+        }
+    }
+
+    auto product = std::make_unique<PipelineDataProduct>();
+    product->setName(entry.productName);
+    product->addTag("unpacked_data");
+    product->addTag("built_by_midas_event_to_bytestream_stage");
+    product->addTag("bank");
+    product->addTag(entry.bankName);
+    product->addTag(entry.typeTag);
+    return product;
+}
+
+void MidasEventToByteStreamStage::onProductsInvalidated() {
+    // The manager now holds "invalid" placeholders under the bank product
+    // names, which must not be picked up as wrappers
+    for (auto& item : bank_templates_) {
+        item.second.published = false;
+    }
+    releaseIdleStreams();
+}
+
+void MidasEventToByteStreamStage::releaseIdleStreams() {
+    // Runs after publishing, when the products replaced in the manager have
+    // let go of their streams. Streams of the current event are still
+    // referenced by their products and are left alone.
+    for (auto& item : bank_templates_) {
+        for (const auto& stream : item.second.streams) {
+            if (stream.use_count() == 1 && stream->owner) {
+                stream->owner.reset();
+                stream->data = nullptr;
+                stream->size = 0;
+            }
+        }
+    }
+}
+
+void MidasEventToByteStreamStage::addMetadataProduct(const TMEvent& event, size_t numBanks) {
+    auto metaPipelineProduct = std::make_unique<PipelineDataProduct>();
 
+    if (json_metadata_) {
         auto metaProduct = std::make_unique<dataProducts::JsonProduct>();
-        metaProduct->jsonString = jmeta.dump();
+        metaProduct->jsonString = metadataJson(event, numBanks).dump();
 
-        auto metaPipelineProduct = std::make_unique<PipelineDataProduct>();
         metaPipelineProduct->setName("event_metadata");
         metaPipelineProduct->setObject(std::move(metaProduct));
         metaPipelineProduct->addTag("event_metadata");
         metaPipelineProduct->addTag("built_by_midas_event_to_bytestream_stage");
 
-        getDataProductManager()->addOrUpdate("event_metadata", std::move(metaPipelineProduct));
+        publish("event_metadata", std::move(metaPipelineProduct));
+        return;
+    }
+
+    auto header = acquireReusable(headers_);
+    header->header = dataProducts::MidasEventHeaderRecord::FromEvent(event, static_cast<uint32_t>(numBanks));
+
+    metaPipelineProduct->setName("event_header");
+    metaPipelineProduct->setSharedObject(header);
+    metaPipelineProduct->addTag("event_metadata");
+    metaPipelineProduct->addTag("built_by_midas_event_to_bytestream_stage");
+
+    publish("event_header", std::move(metaPipelineProduct));
+}
+
+void MidasEventToByteStreamStage::addBatchMetadataProduct(const MidasEventBatch& batch,
+                                                          const std::vector<size_t>& numBanks) {
+    auto metaPipelineProduct = std::make_unique<PipelineDataProduct>();
+
+    if (json_metadata_) {
+        nlohmann::json jmetaBatch = nlohmann::json::array();
+        for (size_t i = 0; i < batch.size(); ++i) {
+            if (batch[i]) jmetaBatch.push_back(metadataJson(*batch[i], numBanks[i]));
+        }
+
+        auto metaProduct = std::make_unique<dataProducts::JsonProduct>();
+        metaProduct->jsonString = jmetaBatch.dump();
+
+        metaPipelineProduct->setName("event_metadata_batch");
+        metaPipelineProduct->setObject(std::move(metaProduct));
+        metaPipelineProduct->addTag("event_metadata");
+        metaPipelineProduct->addTag("batch");
+        metaPipelineProduct->addTag("built_by_midas_event_to_bytestream_stage");
+
+        publish("event_metadata_batch", std::move(metaPipelineProduct));
+        return;
+    }
 
-        spdlog::debug("[{}] Created event metadata product", Name());
+    auto headers = std::make_unique<dataProducts::MidasEventHeaderBatch>();
+    headers->headers.reserve(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (batch[i]) {
+            headers->headers.push_back(
+                dataProducts::MidasEventHeaderRecord::FromEvent(*batch[i], static_cast<uint32_t>(numBanks[i])));
+        }
     }
 
-    // --- Existing bank bytestream products below ---
+    metaPipelineProduct->setName("event_header_batch");
+    metaPipelineProduct->setObject(std::move(headers));
+    metaPipelineProduct->addTag("event_metadata");
+    metaPipelineProduct->addTag("batch");
+    metaPipelineProduct->addTag("built_by_midas_event_to_bytestream_stage");
+
+    publish("event_header_batch", std::move(metaPipelineProduct));
+}
+
+void MidasEventToByteStreamStage::ProcessMidasEvent(std::shared_ptr<TMEvent> event) {
+    if (!event) {
+        spdlog::error("[{}] ProcessMidasEvent called with null event", Name());
+        return;
+    }
+
+    if (lazy_products_) {
+        processLazy(event);
+        return;
+    }
+
+    const auto& banks = selectBanks(*event);
+    if (banks.empty()) {
+        if (bank_selection_->SelectsAll()) {
+            spdlog::warn("[{}] No banks found in event", Name());
+        } else {
+            spdlog::debug("[{}] No selected banks in event {}", Name(), event->serial_number);
+        }
+        releaseIdleStreams();
+        return;
+    }
+
+    // --- Add event metadata product ---
+    addMetadataProduct(*event, banks.size());
+
+    // --- Bank bytestream products ---
     std::vector<std::pair<std::string, std::unique_ptr<PipelineDataProduct>>> products;
+    products.reserve(banks.size());
+
+    // Read through a const event so views over mapped files (TMMmapReader) are
+    // served in place; the non-const accessor refuses to hand out view memory.
+    const TMEvent& constEvent = *event;
+    const bool debugEnabled = spdlog::should_log(spdlog::level::debug);
 
-    for (const auto& bank : event->banks) {
-        const char* rawBankData = event->GetBankData(&bank);
+    for (const TMBank* selected : banks) {
+        const TMBank& bank = *selected;
+        const char* rawBankData = constEvent.GetBankData(&bank);
         if (!rawBankData || bank.data_size == 0) {
             spdlog::warn("[{}] Bank '{}' has null or zero-size data, skipping", Name(), bank.name);
             continue;
         }
 
-        auto byteStream = std::make_shared<dataProducts::ByteStream>();
+        BankTemplate& entry = bankTemplate(bank);
+
+        // Only the pointer, size and owner change from event to event
+        auto byteStream = acquireReusable(entry.streams);
         byteStream->data = reinterpret_cast<const uint8_t*>(rawBankData);
         byteStream->size = bank.data_size;
+        // The event owns the bank bytes, or the file mapping for view events
         byteStream->owner = std::static_pointer_cast<void>(event);
 
-        std::string productName = "bytestream_bank_" + std::string(bank.name) + "_type_" + std::to_string(bank.type);
+        // Name and tags stay; the wrapper lets go of last event's stream here
+        auto product = bankProduct(entry);
+        product->setSharedObject(byteStream);
+        entry.published = true;
+
+        products.emplace_back(entry.productName, std::move(product));
+
+        if (debugEnabled) {
+            spdlog::debug("[{}] Created ByteStream product for bank '{}', size={}, type={}",
+                          Name(), bank.name, bank.data_size, bank.type);
+        }
+    }
+
+    if (!products.empty()) {
+        publishMultiple(std::move(products));
+    } else {
+        spdlog::warn("[{}] No valid bank bytestream products created", Name());
+    }
+    releaseIdleStreams();
+}
+
+void MidasEventToByteStreamStage::ProcessMidasEventBatch(const std::shared_ptr<MidasEventBatch>& batch) {
+    if (!batch || batch->empty()) {
+        spdlog::warn("[{}] ProcessMidasEventBatch called with empty batch", Name());
+        return;
+    }
+
+    if (lazy_products_) {
+        processLazyBatch(batch);
+        return;
+    }
+
+    struct BankGroup {
+        const BankTemplate* entry;
+        std::shared_ptr<dataProducts::ByteStreamBatch> streams;
+    };
+
+    // Groups in order of first appearance, looked up by FOURCC and type
+    std::vector<BankGroup> groups;
+    std::unordered_map<uint64_t, size_t> groupIndex;
+    std::vector<size_t> numBanks(batch->size(), 0);
+
+    for (size_t i = 0; i < batch->size(); ++i) {
+        const auto& event = (*batch)[i];
+        if (!event) {
+            spdlog::error("[{}] Null event in batch, skipping", Name());
+            continue;
+        }
+
+        const auto& banks = selectBanks(*event);
+        numBanks[i] = banks.size();
+
+        const TMEvent& constEvent = *event;
+
+        for (const TMBank* selected : banks) {
+            const TMBank& bank = *selected;
+            const char* rawBankData = constEvent.GetBankData(&bank);
+            if (!rawBankData || bank.data_size == 0) {
+                spdlog::warn("[{}] Bank '{}' has null or zero-size data, skipping", Name(), bank.name);
+                continue;
+            }
+
+            auto it = groupIndex.find(bankKey(bank));
+            if (it == groupIndex.end()) {
+                auto streams = std::make_shared<dataProducts::ByteStreamBatch>();
+                streams->owner = std::static_pointer_cast<void>(batch);
+                it = groupIndex.emplace(bankKey(bank), groups.size()).first;
+                groups.push_back({&bankTemplate(bank), std::move(streams)});
+            }
+
+            groups[it->second].streams->Add(reinterpret_cast<const uint8_t*>(rawBankData),
+                                            bank.data_size, event->serial_number);
+        }
+    }
+
+    // --- Batch metadata product ---
+    addBatchMetadataProduct(*batch, numBanks);
+
+    std::vector<std::pair<std::string, std::unique_ptr<PipelineDataProduct>>> products;
+    products.reserve(groups.size());
+
+    for (auto& group : groups) {
+        const BankTemplate& entry = *group.entry;
 
         auto product = std::make_unique<PipelineDataProduct>();
-        product->setName(productName);
-        product->setSharedObject(byteStream);
+        product->setName(entry.batchProductName);
+        product->setSharedObject(group.streams);
         product->addTag("unpacked_data");
         product->addTag("built_by_midas_event_to_bytestream_stage");
         product->addTag("bank");
-        product->addTag(bank.name);
-        product->addTag("type_" + std::to_string(bank.type));
-
-        products.emplace_back(productName, std::move(product));
+        product->addTag("batch");
+        product->addTag(entry.bankName);
+        product->addTag(entry.typeTag);
 
-        spdlog::debug("[{}] Created ByteStream product for bank '{}', size={}, type={}",
-                      Name(), bank.name, bank.data_size, bank.type);
+        products.emplace_back(entry.batchProductName, std::move(product));
     }
 
+    spdlog::debug("[{}] Created {} batched bank products for {} events", Name(), products.size(), batch->size());
+
     if (!products.empty()) {
-        getDataProductManager()->addOrUpdateMultiple(std::move(products));
+        publishMultiple(std::move(products));
     } else {
-        spdlog::warn("[{}] No valid bank bytestream products created", Name());
+        spdlog::warn("[{}] No valid bank bytestream products created for batch", Name());
     }
 }
 
+void MidasEventToByteStreamStage::processLazy(const std::shared_ptr<TMEvent>& event) {
+    // Builds the bank index Assign() then reuses
+    const size_t numBanks = selectRecords(*event).size();
+
+    auto lazy = std::make_shared<dataProducts::LazyMidasEvent>();
+    lazy->Assign(event, bank_selection_);
+    addMetadataProduct(*event, numBanks);
+
+    auto product = std::make_unique<PipelineDataProduct>();
+    product->setName("event_lazy_bytestream");
+    product->setSharedObject(lazy);
+    product->addTag("unpacked_data");
+    product->addTag("lazy");
+    product->addTag("built_by_midas_event_to_bytestream_stage");
+
+    publish("event_lazy_bytestream", std::move(product));
+}
+
+void MidasEventToByteStreamStage::processLazyBatch(const std::shared_ptr<MidasEventBatch>& batch) {
+    auto lazyBatch = std::make_shared<dataProducts::LazyMidasEventBatch>();
+    lazyBatch->events.reserve(batch->size());
+    std::vector<size_t> numBanks(batch->size(), 0);
+
+    for (size_t i = 0; i < batch->size(); ++i) {
+        const auto& event = (*batch)[i];
+        if (!event) {
+            spdlog::error("[{}] Null event in batch, skipping", Name());
+            continue;
+        }
+        numBanks[i] = selectRecords(*event).size();
+        auto lazy = std::make_shared<dataProducts::LazyMidasEvent>();
+        lazy->Assign(event, bank_selection_);
+        lazyBatch->events.push_back(std::move(lazy));
+    }
+
+    addBatchMetadataProduct(*batch, numBanks);
+
+    auto product = std::make_unique<PipelineDataProduct>();
+    product->setName("event_lazy_bytestream_batch");
+    product->setSharedObject(lazyBatch);
+    product->addTag("unpacked_data");
+    product->addTag("lazy");
+    product->addTag("batch");
+    product->addTag("built_by_midas_event_to_bytestream_stage");
+
+    publish("event_lazy_bytestream_batch", std::move(product));
+}
 
 std::string MidasEventToByteStreamStage::Name() const {
     return "MidasEventToByteStreamStage";
@@ -1,5 +1,6 @@
 // MidasEventToJsonStage.cpp
 #include "analysis_pipeline/midas_event_unpacker/stages/midas_event_to_json_stage.h"
+#include "analysis_pipeline/midas_event_unpacker/serialization/midas_json_writer.h"
 #include <sstream>
 #include <iomanip>
 #include <spdlog/spdlog.h>
@@ -8,6 +9,7 @@ ClassImp(MidasEventToJsonStage)
 
 using json = nlohmann::json;
 
+
 MidasEventToJsonStage::MidasEventToJsonStage() {
     spdlog::debug("[{}] Constructor called", Name());
 }
@@ -16,26 +18,164 @@ MidasEventToJsonStage::~MidasEventToJsonStage() {
     spdlog::debug("[{}] Destructor called", Name());
 }
 
+void MidasEventToJsonStage::OnInit() {
+    MidasEventUnpackerStage::OnInit();
+
+    lazy_products_ = parameters_.value("lazy_products", false);
+
+    std::string serializer = parameters_.value("serializer", std::string("streaming"));
+    if (serializer == "streaming") {
+        streaming_serializer_ = true;
+    } else if (serializer == "dom") {
+        streaming_serializer_ = false;
+    } else {
+        throw std::runtime_error("MidasEventToJsonStage: unknown serializer '" + serializer +
+                                 "', expected 'streaming' or 'dom'");
+    }
+    spdlog::debug("[{}] Using {} serializer{}", Name(), serializer, lazy_products_ ? ", lazy products" : "");
+}
+
+std::shared_ptr<dataProducts::LazyMidasEvent> MidasEventToJsonStage::makeLazyEvent(std::shared_ptr<TMEvent> event) const {
+    auto lazy = std::make_shared<dataProducts::LazyMidasEvent>();
+    lazy->Assign(std::move(event), bank_selection_);
+    return lazy;
+}
+
 void MidasEventToJsonStage::ProcessMidasEvent(std::shared_ptr<TMEvent> event) {
     if (!event) {
         spdlog::error("[{}] ProcessMidasEvent called with null event", Name());
         return;
     }
 
+    if (lazy_products_) {
+        selectRecords(*event);  // bank index scan, timed and counted like the eager path
+        auto product = std::make_unique<PipelineDataProduct>();
+        product->setName("event_lazy_json");
+        product->setSharedObject(makeLazyEvent(event));
+        product->addTag("unpacked_data");
+        product->addTag("lazy");
+        product->addTag("built_by_midas_event_to_json_stage");
+
+        publish("event_lazy_json", std::move(product));
+        return;
+    }
+
+    // Create shared_ptr to JsonProduct object
+    auto jsonProduct = std::make_unique<dataProducts::JsonProduct>();
+    if (streaming_serializer_) {
+        json_buffer_.clear();
+        serializeStreaming(*event, selectBanks(*event), json_buffer_);
+        takeJsonBuffer(jsonProduct->jsonString);
+    } else {
+        jsonProduct->jsonString = serializeWithDom(*event, selectBanks(*event));
+    }
+
+    // Wrap in PipelineDataProduct
+    auto product = std::make_unique<PipelineDataProduct>();
+    product->setName("event_json");
+    product->setObject(std::move(jsonProduct));
+    product->addTag("unpacked_data");
+    product->addTag("built_by_midas_event_to_json_stage");
+
+    publish("event_json", std::move(product));
+
+    spdlog::debug("[{}] Created JsonProduct PipelineDataProduct for event_json", Name());
+}
+
+void MidasEventToJsonStage::ProcessMidasEventBatch(const std::shared_ptr<MidasEventBatch>& batch) {
+    if (!batch || batch->empty()) {
+        spdlog::warn("[{}] ProcessMidasEventBatch called with empty batch", Name());
+        return;
+    }
+
+    if (lazy_products_) {
+        auto lazyBatch = std::make_shared<dataProducts::LazyMidasEventBatch>();
+        lazyBatch->events.reserve(batch->size());
+        for (const auto& event : *batch) {
+            if (!event) continue;
+            selectRecords(*event);
+            lazyBatch->events.push_back(makeLazyEvent(event));
+        }
+
+        auto product = std::make_unique<PipelineDataProduct>();
+        product->setName("event_lazy_json_batch");
+        product->setSharedObject(lazyBatch);
+        product->addTag("unpacked_data");
+        product->addTag("lazy");
+        product->addTag("batch");
+        product->addTag("built_by_midas_event_to_json_stage");
+
+        publish("event_lazy_json_batch", std::move(product));
+        return;
+    }
+
+    // Same bytes as dumping a json::array of the per-event objects
+    json_buffer_.clear();
+    json_buffer_.push_back('[');
+    bool first = true;
+    for (const auto& event : *batch) {
+        if (!event) {
+            spdlog::error("[{}] Null event in batch, skipping", Name());
+            continue;
+        }
+        if (!first) json_buffer_.push_back(',');
+        first = false;
+        if (streaming_serializer_) {
+            serializeStreaming(*event, selectBanks(*event), json_buffer_);
+        } else {
+            json_buffer_ += serializeWithDom(*event, selectBanks(*event));
+        }
+    }
+    json_buffer_.push_back(']');
+
+    auto jsonProduct = std::make_unique<dataProducts::JsonProduct>();
+    takeJsonBuffer(jsonProduct->jsonString);
+
+    auto product = std::make_unique<PipelineDataProduct>();
+    product->setName("event_json_batch");
+    product->setObject(std::move(jsonProduct));
+    product->addTag("unpacked_data");
+    product->addTag("batch");
+    product->addTag("built_by_midas_event_to_json_stage");
+
+    publish("event_json_batch", std::move(product));
+
+    spdlog::debug("[{}] Created event_json_batch for {} events", Name(), batch->size());
+}
+
+std::string MidasEventToJsonStage::SerializeEvent(TMEvent& event) {
+    if (!streaming_serializer_) {
+        return serializeWithDom(event, selectBanks(event));
+    }
+    std::string out;
+    serializeStreaming(event, selectBanks(event), out);
+    return out;
+}
+
+void MidasEventToJsonStage::takeJsonBuffer(std::string& target) {
+    // The product takes the buffer as it is; the next event starts from one
+    // allocation of the same size instead of growing from empty.
+    const size_t size = json_buffer_.size();
+    target.swap(json_buffer_);
+    json_buffer_.clear();
+    json_buffer_.reserve(size);
+}
+
+std::string MidasEventToJsonStage::serializeWithDom(const TMEvent& event, const std::vector<const TMBank*>& banks) const {
     json j;
-    j["event_id"] = event->event_id;
-    j["serial_number"] = event->serial_number;
-    j["trigger_mask"] = event->trigger_mask;
-    j["timestamp"] = event->time_stamp;
-    j["data_size"] = event->data_size;
-    j["event_header_size"] = event->event_header_size;
-    j["bank_header_flags"] = event->bank_header_flags;
+    j["event_id"] = event.event_id;
+    j["serial_number"] = event.serial_number;
+    j["trigger_mask"] = event.trigger_mask;
+    j["timestamp"] = event.time_stamp;
+    j["data_size"] = event.data_size;
+    j["event_header_size"] = event.event_header_size;
+    j["bank_header_flags"] = event.bank_header_flags;
 
-    event->FindAllBanks();
-    spdlog::debug("[{}] Found {} banks", Name(), event->banks.size());
+    spdlog::debug("[{}] Selected {} banks", Name(), banks.size());
 
     j["banks"] = json::array();
-    for (const auto& bank : event->banks) {
+    for (const TMBank* selected : banks) {
+        const TMBank& bank = *selected;
         spdlog::debug("[{}] Processing bank: name='{}', type={}, data_size={}",
                       Name(), bank.name, bank.type, bank.data_size);
 
@@ -43,27 +183,52 @@ void MidasEventToJsonStage::ProcessMidasEvent(std::shared_ptr<TMEvent> event) {
         jbank["name"] = bank.name;
         jbank["type"] = bank.type;
         jbank["data_size"] = bank.data_size;
-        jbank["data"] = decodeBankData(bank, *event);
+        jbank["data"] = decodeBankData(bank, event);
 
         j["banks"].push_back(std::move(jbank));
     }
 
-    // Create shared_ptr to JsonProduct object
-    auto jsonProduct = std::make_unique<dataProducts::JsonProduct>();
-    jsonProduct->jsonString = j.dump();
+    return j.dump();
+}
 
-    // Wrap in PipelineDataProduct
-    auto product = std::make_unique<PipelineDataProduct>();
-    product->setName("event_json");
-    product->setObject(std::move(jsonProduct));
-    product->addTag("unpacked_data");
-    product->addTag("built_by_midas_event_to_json_stage");
+void MidasEventToJsonStage::serializeStreaming(const TMEvent& event, const std::vector<const TMBank*>& banks,
+                                               std::string& out) const {
+    using namespace midas_json;
 
-    getDataProductManager()->addOrUpdate("event_json", std::move(product));
+    // nlohmann::json objects keep their keys sorted, so the keys are written
+    // in alphabetical order here.
+    out.append("{\"bank_header_flags\":");
+    AppendUnsigned(out, event.bank_header_flags);
 
-    spdlog::debug("[{}] Created JsonProduct PipelineDataProduct for event_json", Name());
-}
+    out.append(",\"banks\":[");
+    bool first = true;
+    for (const TMBank* bank : banks) {
+        if (!first) out.push_back(',');
+        first = false;
 
+        const char* bankData = event.GetBankData(bank);
+        if (!bankData || bank->data_size == 0) {
+            spdlog::warn("[{}] Bank '{}' has null data or zero size", Name(), bank->name);
+        } else if (!IsDecodedType(bank->type)) {
+            spdlog::warn("[{}] Unknown bank type {}. Returning hex string", Name(), bank->type);
+        }
+        AppendBank(out, bank->name, bank->type, bankData, bank->data_size);
+    }
+
+    out.append("],\"data_size\":");
+    AppendUnsigned(out, event.data_size);
+    out.append(",\"event_header_size\":");
+    AppendUnsigned(out, event.event_header_size);
+    out.append(",\"event_id\":");
+    AppendUnsigned(out, event.event_id);
+    out.append(",\"serial_number\":");
+    AppendUnsigned(out, event.serial_number);
+    out.append(",\"timestamp\":");
+    AppendUnsigned(out, event.time_stamp);
+    out.append(",\"trigger_mask\":");
+    AppendUnsigned(out, event.trigger_mask);
+    out.push_back('}');
+}
 
 json MidasEventToJsonStage::decodeBankData(const TMBank& bank, const TMEvent& event) const {
     const char* bankData = event.GetBankData(&bank);
@@ -151,7 +316,7 @@ std::string MidasEventToJsonStage::toHexString(const char* data, size_t size) co
             << (static_cast<uint8_t>(data[i]) & 0xFF);
     }
     std::string hexStr = oss.str();
-    spdlog::debug("[{}] Converted data to hex string: {}", Name(), hexStr);
+    spdlog::debug("[{}] Converted data to hex string of {} characters", Name(), hexStr.size());
     return hexStr;
 }
 
@@ -1,4 +1,6 @@
 #include "analysis_pipeline/midas_event_unpacker/stages/midas_event_unpacker_stage.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
 #include <stdexcept>
 
 ClassImp(MidasEventUnpackerStage)
@@ -6,9 +8,29 @@ ClassImp(MidasEventUnpackerStage)
 MidasEventUnpackerStage::MidasEventUnpackerStage() = default;
 MidasEventUnpackerStage::~MidasEventUnpackerStage() = default;
 
+void MidasEventUnpackerStage::OnInit() {
+    if (parameters_.contains("bank_selection")) {
+        bank_selection_ = std::make_shared<const BankSelection>(
+            BankSelection::FromJson(parameters_.at("bank_selection")));
+    } else {
+        bank_selection_ = std::make_shared<const BankSelection>();
+    }
+
+    metrics_interval_ = parameters_.value("metrics_interval", uint64_t(0));
+    metrics_sample_period_ = std::max<uint64_t>(1, parameters_.value("metrics_sample_period", uint64_t(8)));
+    if (metrics_interval_ > 0 && !MIDAS_UNPACKER_INSTRUMENTATION) {
+        spdlog::warn("MidasEventUnpackerStage: metrics_interval set, but instrumentation is compiled out");
+    }
+}
+
 void MidasEventUnpackerStage::SetInput(const InputBundle& input) {
+    if (input.has<MidasEventBatch>("TMEventBatch")) {
+        auto batch = input.get<MidasEventBatch>("TMEventBatch");
+        SetCurrentBatch(std::make_shared<MidasEventBatch>(std::move(batch)));
+        return;
+    }
     if (!input.has<std::shared_ptr<TMEvent>>("TMEvent")) {
-        throw std::runtime_error("MidasEventUnpackerStage::SetInput - InputBundle missing TMEvent");
+        throw std::runtime_error("MidasEventUnpackerStage::SetInput - InputBundle missing TMEvent or TMEventBatch");
     }
     auto event = input.get<std::shared_ptr<TMEvent>>("TMEvent");
     SetCurrentEvent(event);
@@ -16,11 +38,202 @@ void MidasEventUnpackerStage::SetInput(const InputBundle& input) {
 
 void MidasEventUnpackerStage::SetCurrentEvent(std::shared_ptr<TMEvent> event) {
     current_event_ = std::move(event);
+    current_batch_.reset();
+}
+
+void MidasEventUnpackerStage::SetCurrentBatch(std::shared_ptr<MidasEventBatch> batch) {
+    current_batch_ = std::move(batch);
+    current_event_.reset();
 }
 
 void MidasEventUnpackerStage::Process() {
+    if (!bank_selection_) {
+        bank_selection_ = std::make_shared<const BankSelection>();
+    }
+
+    // Counters see every call, the phase timers every metrics_sample_period-th
+    timing_call_ = MIDAS_UNPACKER_INSTRUMENTATION && ++calls_ % metrics_sample_period_ == 0;
+    const uint64_t startNs = timerNow();
+    call_scan_ns_ = 0;
+    call_publish_ns_ = 0;
+
+    if (processCurrentInput()) {
+        if (timing_call_) {
+            recordPhases(startNs);
+        }
+    } else {
+        invalidateProducts();
+    }
+    publishMetricsIfDue();
+}
+
+bool MidasEventUnpackerStage::processCurrentInput() {
+    if (current_batch_) {
+        if (!bank_selection_->SelectsAll()) {
+            auto accepted = std::make_shared<MidasEventBatch>();
+            accepted->reserve(current_batch_->size());
+            for (const auto& event : *current_batch_) {
+                if (!event || bank_selection_->AcceptsEvent(*event)) {
+                    accepted->push_back(event);
+                } else {
+                    metrics_.CountRejectedEvent();
+                }
+            }
+            if (accepted->empty()) {
+                spdlog::debug("MidasEventUnpackerStage: no event of the batch passes the bank selection");
+                return false;
+            }
+            if (accepted->size() != current_batch_->size()) {
+                current_batch_ = std::move(accepted);
+            }
+        }
+
+        metrics_.CountBatch();
+        for (const auto& event : *current_batch_) {
+            if (event) {
+                metrics_.CountEvent(event->EventSize());
+                ++events_since_metrics_;
+            }
+        }
+        ProcessMidasEventBatch(current_batch_);
+        return true;
+    }
     if (!current_event_) {
         throw std::runtime_error("MidasEventUnpackerStage: current_event_ not set");
     }
+    if (!bank_selection_->AcceptsEvent(*current_event_)) {
+        metrics_.CountRejectedEvent();
+        return false;
+    }
+
+    metrics_.CountEvent(current_event_->EventSize());
+    ++events_since_metrics_;
     ProcessMidasEvent(current_event_);
-}
\ No newline at end of file
+    return true;
+}
+
+void MidasEventUnpackerStage::recordPhases(uint64_t startNs) {
+#if MIDAS_UNPACKER_INSTRUMENTATION
+    const uint64_t totalNs = UnpackerMetricsRecorder::Now() - startNs;
+    const uint64_t measuredNs = call_scan_ns_ + call_publish_ns_;
+    metrics_.RecordPhase(UnpackerPhase::kTotal, totalNs);
+    metrics_.RecordPhase(UnpackerPhase::kScan, call_scan_ns_);
+    metrics_.RecordPhase(UnpackerPhase::kPublish, call_publish_ns_);
+    metrics_.RecordPhase(UnpackerPhase::kBuild, totalNs > measuredNs ? totalNs - measuredNs : 0);
+#else
+    (void)startNs;
+#endif
+}
+
+void MidasEventUnpackerStage::publishMetricsIfDue() {
+    if (!MIDAS_UNPACKER_INSTRUMENTATION || metrics_interval_ == 0 || events_since_metrics_ < metrics_interval_) {
+        return;
+    }
+    events_since_metrics_ = 0;
+
+    std::string productName = "unpacker_metrics_" + Name();
+
+    auto product = std::make_unique<PipelineDataProduct>();
+    product->setName(productName);
+    product->setSharedObject(GetMetrics());
+    product->addTag("metrics");
+    product->addTag("built_by_midas_event_unpacker_stage");
+
+    getDataProductManager()->addOrUpdate(productName, std::move(product));
+}
+
+std::shared_ptr<dataProducts::UnpackerMetrics> MidasEventUnpackerStage::GetMetrics() const {
+    auto snapshot = std::make_shared<dataProducts::UnpackerMetrics>();
+    snapshot->stageName = Name();
+    metrics_.Snapshot(*snapshot);
+    return snapshot;
+}
+
+void MidasEventUnpackerStage::DumpMetrics() const {
+    spdlog::info("[{}] metrics: {}", Name(), GetMetrics()->ToJson());
+}
+
+void MidasEventUnpackerStage::ProcessMidasEventBatch(const std::shared_ptr<MidasEventBatch>& batch) {
+    for (const auto& event : *batch) {
+        ProcessMidasEvent(event);
+    }
+}
+
+const std::vector<const TMBank*>& MidasEventUnpackerStage::selectBanks(TMEvent& event) {
+    const uint64_t startNs = timerNow();
+    bank_selection_->SelectBanks(event, selected_banks_);
+    call_scan_ns_ += timerNow() - startNs;
+
+#if MIDAS_UNPACKER_INSTRUMENTATION
+    metrics_.BeginEventBanks();
+    for (const TMBank* bank : selected_banks_) {
+        metrics_.CountBank(TMFourCC(bank->name.c_str()), bank->data_size);
+    }
+#endif
+    return selected_banks_;
+}
+
+const std::vector<const TMBankRecord*>& MidasEventUnpackerStage::selectRecords(TMEvent& event) {
+    const uint64_t startNs = timerNow();
+    bank_selection_->SelectRecords(event, selected_records_);
+    call_scan_ns_ += timerNow() - startNs;
+
+#if MIDAS_UNPACKER_INSTRUMENTATION
+    metrics_.BeginEventBanks();
+    for (const TMBankRecord* record : selected_records_) {
+        metrics_.CountBank(record->fourcc, record->data_size);
+    }
+#endif
+    return selected_records_;
+}
+
+void MidasEventUnpackerStage::notePublished(const std::string& name) {
+    // Names repeat from event to event, so this is a lookup without allocation
+    if (published_names_.find(name) == published_names_.end()) {
+        published_names_.insert(name);
+    }
+}
+
+void MidasEventUnpackerStage::invalidateProducts() {
+    if (!products_valid_) {
+        return;
+    }
+    products_valid_ = false;
+
+    // Replacing the products also releases the event they point into
+    std::vector<std::pair<std::string, std::unique_ptr<PipelineDataProduct>>> products;
+    products.reserve(published_names_.size());
+    for (const auto& name : published_names_) {
+        auto product = std::make_unique<PipelineDataProduct>();
+        product->setName(name);
+        product->addTag("invalid");
+        product->addTag("rejected_event");
+        products.emplace_back(name, std::move(product));
+    }
+    getDataProductManager()->addOrUpdateMultiple(std::move(products));
+    onProductsInvalidated();
+
+    spdlog::debug("MidasEventUnpackerStage: input rejected, invalidated {} products", published_names_.size());
+}
+
+void MidasEventUnpackerStage::publish(const std::string& name, std::unique_ptr<PipelineDataProduct> product) {
+    notePublished(name);
+    products_valid_ = true;
+    const uint64_t startNs = timerNow();
+    getDataProductManager()->addOrUpdate(name, std::move(product));
+    call_publish_ns_ += timerNow() - startNs;
+    metrics_.CountProducts(1);
+}
+
+void MidasEventUnpackerStage::publishMultiple(
+    std::vector<std::pair<std::string, std::unique_ptr<PipelineDataProduct>>> products) {
+    for (const auto& product : products) {
+        notePublished(product.first);
+    }
+    products_valid_ = true;
+    const uint64_t startNs = timerNow();
+    const size_t count = products.size();
+    getDataProductManager()->addOrUpdateMultiple(std::move(products));
+    call_publish_ns_ += timerNow() - startNs;
+    metrics_.CountProducts(count);
+}
@@ -0,0 +1,112 @@
+#include "analysis_pipeline/midas_event_unpacker/stages/midas_event_writer_stage.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <stdexcept>
+
+ClassImp(MidasEventWriterStage)
+
+namespace {
+
+bool hasSuffix(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+} // namespace
+
+MidasEventWriterStage::MidasEventWriterStage() {
+    spdlog::debug("[{}] Constructor called", Name());
+}
+
+MidasEventWriterStage::~MidasEventWriterStage() {
+    spdlog::debug("[{}] Destructor called", Name());
+    try {
+        Close();
+    } catch (const std::exception& e) {
+        spdlog::error("[{}] {}", Name(), e.what());
+    }
+}
+
+void MidasEventWriterStage::OnInit() {
+    MidasEventUnpackerStage::OnInit();
+
+    if (!parameters_.contains("output_file")) {
+        throw std::runtime_error("MidasEventWriterStage: missing 'output_file' parameter");
+    }
+    output_file_ = parameters_.at("output_file").get<std::string>();
+    if (hasSuffix(output_file_, ".gz") || hasSuffix(output_file_, ".bz2")) {
+        throw std::runtime_error("MidasEventWriterStage: cannot write '" + output_file_ +
+                                 "', only .lz4 and uncompressed output are supported");
+    }
+
+    if (parameters_.contains("filter")) {
+        filter_ = EventFilter::FromJson(parameters_.at("filter"));
+    }
+    prescale_ = std::max<uint64_t>(1, parameters_.value("prescale", uint64_t(1)));
+
+    Close();  // re-initialization starts a new file
+    events_passed_ = 0;
+    events_written_ = 0;
+    bytes_written_ = 0;
+
+    if (hasSuffix(output_file_, ".lz4")) {
+        int level = parameters_.value("lz4_level", 1);
+        int threads = parameters_.value("lz4_threads", 2);
+        bool checksum = parameters_.value("lz4_checksum", true);
+        writer_.reset(TMNewLz4Writer(TMNewFileWriter(output_file_.c_str()), level, checksum, threads));
+        spdlog::debug("[{}] Writing '{}' with LZ4 level {}, {} threads", Name(), output_file_, level, threads);
+    } else {
+        writer_.reset(TMNewFileWriter(output_file_.c_str()));
+    }
+    if (writer_->fError) {
+        std::string error = writer_->fErrorString;
+        writer_.reset();
+        throw std::runtime_error("MidasEventWriterStage: cannot open '" + output_file_ + "': " + error);
+    }
+}
+
+void MidasEventWriterStage::SetPredicate(Predicate predicate) {
+    predicate_ = std::move(predicate);
+}
+
+void MidasEventWriterStage::ProcessMidasEvent(std::shared_ptr<TMEvent> event) {
+    if (!event) {
+        spdlog::error("[{}] ProcessMidasEvent called with null event", Name());
+        return;
+    }
+    if (!writer_) {
+        throw std::runtime_error("MidasEventWriterStage: no output open, Init() not called or Close() already called");
+    }
+
+    if (!filter_.Accepts(*event) || (predicate_ && !predicate_(*event))) {
+        metrics_.CountRejectedEvent();
+        return;
+    }
+    if (events_passed_++ % prescale_ != 0) {
+        return;
+    }
+
+    TMWriteEvent(writer_.get(), event.get());
+    if (writer_->fError) {
+        throw std::runtime_error("MidasEventWriterStage: cannot write '" + output_file_ + "': " +
+                                 writer_->fErrorString);
+    }
+    ++events_written_;
+    bytes_written_ += event->EventSize();
+}
+
+void MidasEventWriterStage::Close() {
+    if (!writer_) {
+        return;
+    }
+    std::unique_ptr<TMWriterInterface> writer = std::move(writer_);
+    int status = writer->Close();
+    if (status != 0 || writer->fError) {
+        throw std::runtime_error("MidasEventWriterStage: cannot complete '" + output_file_ + "': " +
+                                 writer->fErrorString);
+    }
+    spdlog::info("[{}] Wrote {} events ({} bytes) to '{}'", Name(), events_written_, bytes_written_, output_file_);
+}
+
+std::string MidasEventWriterStage::Name() const {
+    return "MidasEventWriterStage";
+}
@@ -0,0 +1,128 @@
+// MidasEventToByteStreamStage reuses ByteStream objects and the product
+// wrappers around them across events. An idle pooled object must not keep
+// the event it last pointed into alive, and neither must the products left
+// behind when the bank selection rejects an event.
+
+#include "analysis_pipeline/midas_event_unpacker/stages/midas_event_to_byte_stream_stage.h"
+#include "test_check.h"
+#include "test_fixtures.h"
+#include <nlohmann/json.hpp>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::shared_ptr<TMEvent> makeEvent(uint32_t serial, const std::vector<std::string>& bankNames,
+                                   uint16_t eventId = 1) {
+    TMEvent built;
+    built.Init(eventId, 0, serial, 1700000000);
+    for (const std::string& name : bankNames) {
+        uint32_t payload[4] = {serial, 1, 2, 3};
+        built.AddBank(name.c_str(), TID_UINT32, reinterpret_cast<const char*>(payload), sizeof(payload));
+    }
+    return std::make_shared<TMEvent>(built.data.data(), built.data.size());
+}
+
+const std::string kAdcProduct = "bytestream_bank_ADC0_type_" + std::to_string(TID_UINT32);
+
+// The product currently published under name, left in place
+const PipelineDataProduct* peekProduct(PipelineDataProductManager& manager, const std::string& name) {
+    auto product = manager.extractProduct(name);
+    const PipelineDataProduct* raw = product.get();
+    if (product) manager.addOrUpdate(name, std::move(product));
+    return raw;
+}
+
+// First payload word of the ADC0 product, the event serial number
+uint32_t adcSerial(const PipelineDataProduct* product) {
+    auto stream = dynamic_cast<const dataProducts::ByteStream*>(product->getObject());
+    if (!stream || stream->size < sizeof(uint32_t)) return ~0u;
+    uint32_t serial;
+    memcpy(&serial, stream->data, sizeof(serial));
+    return serial;
+}
+
+bool isBankProduct(const PipelineDataProduct* product) {
+    return product && product->hasTag("bank") && product->hasTag("ADC0") && !product->hasTag("invalid");
+}
+
+void testRejectedEvent() {
+    PipelineDataProductManager manager;
+    MidasEventToByteStreamStage stage;
+    stage.Init(nlohmann::json{{"bank_selection", {{"event_ids", {1}}}}}, &manager);
+
+    auto accepted = makeEvent(1, {"ADC0"});
+    std::weak_ptr<TMEvent> acceptedRef = accepted;
+    ProcessEvent(stage, std::move(accepted));
+    CHECK(!acceptedRef.expired());
+
+    // Event ID 2 is not selected: the products of event 1 are invalidated
+    ProcessEvent(stage, makeEvent(2, {"ADC0"}, 2));
+    CHECK(acceptedRef.expired());
+
+    // and accepted input publishes normally again, with a fresh wrapper
+    // rather than the "invalid" placeholder
+    auto next = makeEvent(3, {"ADC0"});
+    std::weak_ptr<TMEvent> nextRef = next;
+    ProcessEvent(stage, std::move(next));
+    CHECK(!nextRef.expired());
+    const PipelineDataProduct* product = peekProduct(manager, kAdcProduct);
+    CHECK(isBankProduct(product));
+    CHECK(product && adcSerial(product) == 3);
+}
+
+void testWrapperReuse() {
+    PipelineDataProductManager manager;
+    MidasEventToByteStreamStage stage;
+    stage.Init(nlohmann::json::object(), &manager);
+
+    ProcessEvent(stage, makeEvent(1, {"ADC0"}));
+    const PipelineDataProduct* first = peekProduct(manager, kAdcProduct);
+    CHECK(isBankProduct(first));
+
+    // the same wrapper, keeping its tags, now points into each new event
+    bool reused = true;
+    for (uint32_t serial = 2; serial < 10; ++serial) {
+        ProcessEvent(stage, makeEvent(serial, serial % 3 ? std::vector<std::string>{"ADC0", "TDC0"}
+                                                         : std::vector<std::string>{"ADC0"}));
+        const PipelineDataProduct* product = peekProduct(manager, kAdcProduct);
+        if (product != first || !isBankProduct(product) || adcSerial(product) != serial) reused = false;
+    }
+    CHECK(reused);
+}
+
+} // namespace
+
+int main() {
+    testRejectedEvent();
+    testWrapperReuse();
+
+    PipelineDataProductManager manager;
+    MidasEventToByteStreamStage stage;
+    stage.Init(nlohmann::json::object(), &manager);
+
+    auto first = makeEvent(1, {"ADC0", "TDC0"});
+    std::weak_ptr<TMEvent> firstRef = first;
+    ProcessEvent(stage, std::move(first));
+    CHECK(!firstRef.expired());  // its products are the current ones
+
+    // The second event replaces every product of the first. The first
+    // event's ByteStreams go back to the pool and must let go of it, even
+    // though ADC0 and TDC0 never appear again.
+    auto second = makeEvent(2, {"ADC0", "TDC0"});
+    ProcessEvent(stage, std::move(second));
+    CHECK(firstRef.expired());
+
+    for (uint32_t serial = 3; serial < 20; ++serial) {
+        ProcessEvent(stage, makeEvent(serial, {"SCL0"}));
+    }
+    auto last = makeEvent(20, {"SCL0"});
+    std::weak_ptr<TMEvent> lastRef = last;
+    ProcessEvent(stage, std::move(last));
+    ProcessEvent(stage, makeEvent(21, {"SCL0"}));
+    CHECK(lastRef.expired());
+
+    return TestExitCode();
+}
@@ -0,0 +1,46 @@
+#ifndef MIDAS_EVENT_UNPACKER_TEST_CHECK_H
+#define MIDAS_EVENT_UNPACKER_TEST_CHECK_H
+
+#include <cstdio>
+
+/**
+ * Minimal checks for the test executables. A failed CHECK is reported with
+ * its location and counted; main() returns TestExitCode() so ctest sees the
+ * failure, and the remaining checks still run.
+ */
+inline int& TestFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+inline int TestExitCode() {
+    if (TestFailures() > 0) {
+        fprintf(stderr, "%d check(s) failed\n", TestFailures());
+        return 1;
+    }
+    return 0;
+}
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++TestFailures();                                                        \
+        }                                                                            \
+    } while (0)
+
+#define CHECK_THROWS(expr, exception)                                                        \
+    do {                                                                                     \
+        bool thrown = false;                                                                 \
+        try {                                                                                \
+            expr;                                                                            \
+        } catch (const exception&) {                                                         \
+            thrown = true;                                                                   \
+        }                                                                                    \
+        if (!thrown) {                                                                       \
+            fprintf(stderr, "%s:%d: %s did not throw %s\n", __FILE__, __LINE__, #expr, #exception); \
+            ++TestFailures();                                                                \
+        }                                                                                    \
+    } while (0)
+
+#endif // MIDAS_EVENT_UNPACKER_TEST_CHECK_H
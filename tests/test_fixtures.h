@@ -0,0 +1,93 @@
+#ifndef MIDAS_EVENT_UNPACKER_TEST_FIXTURES_H
+#define MIDAS_EVENT_UNPACKER_TEST_FIXTURES_H
+
+#include "analysis_pipeline/midas_event_unpacker/stages/midas_event_unpacker_stage.h"
+#include "midasio.h"
+#include "mlz4frame.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+/**
+ * Inputs shared by the test executables: raw MIDAS event streams, LZ4
+ * frames of them, temporary files and feeding an event to a stage.
+ */
+
+// count raw MIDAS events, the i-th with serial number serialAt(i) and a
+// "DATA" bank of 1 to 8 words serial * 8 + j
+template <typename SerialAt>
+std::string MakeEventBytes(uint32_t count, SerialAt serialAt) {
+    std::string bytes;
+    TMEvent event;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t serial = serialAt(i);
+        event.Init(1, 0, serial, 1700000000);
+        uint32_t payload[8];
+        for (uint32_t j = 0; j < 8; ++j) payload[j] = serial * 8 + j;
+        event.AddBank("DATA", TID_UINT32, reinterpret_cast<const char*>(payload), (serial % 8 + 1) * 4);
+        bytes.append(event.data.data(), event.data.size());
+    }
+    return bytes;
+}
+
+// Serials first..first+count-1
+inline std::string MakeEventBytes(uint32_t first, uint32_t count) {
+    return MakeEventBytes(count, [first](uint32_t i) { return first + i; });
+}
+
+// One LZ4 frame of 64 kB independent blocks, so a frame has many blocks
+inline std::string CompressLz4Frame(const std::string& data, bool contentChecksum) {
+    MLZ4F_preferences_t prefs;
+    memset(&prefs, 0, sizeof(prefs));
+    prefs.frameInfo.blockSizeID = MLZ4F_max64KB;
+    prefs.frameInfo.blockMode = MLZ4F_blockIndependent;
+    prefs.frameInfo.contentChecksumFlag = contentChecksum ? MLZ4F_contentChecksumEnabled : MLZ4F_noContentChecksum;
+    std::string frame(MLZ4F_compressFrameBound(data.size(), &prefs), '\0');
+    size_t size = MLZ4F_compressFrame(&frame[0], frame.size(), data.data(), data.size(), &prefs);
+    if (MLZ4F_isError(size)) {
+        fprintf(stderr, "MLZ4F_compressFrame: %s\n", MLZ4F_getErrorName(size));
+        abort();
+    }
+    frame.resize(size);
+    return frame;
+}
+
+// File in /tmp with the given contents and suffix, removed on destruction
+class TempFile {
+public:
+    TempFile(const std::string& contents, const char* suffix) {
+        std::string name = std::string("/tmp/midas_unpacker_test_XXXXXX") + suffix;
+        std::vector<char> buf(name.begin(), name.end());
+        buf.push_back('\0');
+        int fd = mkstemps(buf.data(), static_cast<int>(strlen(suffix)));
+        if (fd < 0 || write(fd, contents.data(), contents.size()) != static_cast<ssize_t>(contents.size())) {
+            perror("mkstemps");
+            abort();
+        }
+        close(fd);
+        path_ = buf.data();
+    }
+    ~TempFile() { unlink(path_.c_str()); }
+
+    TempFile(const TempFile&) = delete;
+    TempFile& operator=(const TempFile&) = delete;
+
+    const std::string& Path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+// Run one Process() call of stage on event
+inline void ProcessEvent(MidasEventUnpackerStage& stage, std::shared_ptr<TMEvent> event) {
+    InputBundle input;
+    input.set("TMEvent", std::move(event));
+    stage.SetInput(input);
+    stage.Process();
+}
+
+#endif // MIDAS_EVENT_UNPACKER_TEST_FIXTURES_H
@@ -0,0 +1,109 @@
+// IndexedEventReader on a range from MidasEventIndex::SerialRange() must
+// return exactly the events with matching serial numbers, also when the
+// serials are not sorted through the file. Lz4BlockReader must verify the
+// LZ4 content checksum of frames it decodes from the start.
+
+#include "analysis_pipeline/midas_event_unpacker/io/indexed_event_reader.h"
+#include "analysis_pipeline/midas_event_unpacker/io/lz4_block_reader.h"
+#include "analysis_pipeline/midas_event_unpacker/io/midas_event_index.h"
+#include "test_check.h"
+#include "test_fixtures.h"
+#include <spdlog/spdlog.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+const uint32_t kEvents = 5000;
+
+// Serial numbers in file order: a permutation of 0..kEvents-1
+uint32_t serialAt(uint32_t i) {
+    return (i * 7919) % kEvents;
+}
+
+void testSerialRange(const std::string& path) {
+    auto index = std::make_shared<MidasEventIndex>(MidasEventIndex::Build(path));
+    CHECK(index->Size() == kEvents);
+
+    const uint32_t first = 100;
+    const uint32_t last = 199;
+    MidasEventRange range = index->SerialRange(first, last);
+    CHECK(range.Size() > last - first + 1);  // spans non-matching entries
+
+    IndexedEventReader reader(path, index);
+    reader.SetRange(range);
+    std::vector<bool> seen(kEvents, false);
+    uint32_t count = 0;
+    bool inRange = true;
+    while (auto event = reader.Next()) {
+        if (event->serial_number < first || event->serial_number > last) inRange = false;
+        seen[event->serial_number] = true;
+        ++count;
+    }
+    CHECK(!reader.HasError());
+    CHECK(inRange);
+    CHECK(count == last - first + 1);
+    for (uint32_t serial = first; serial <= last; ++serial) {
+        CHECK(seen[serial]);
+    }
+
+    // a single serial, and one that does not exist
+    reader.SetRange(index->SerialRange(4321, 4321));
+    auto event = reader.Next();
+    CHECK(event && event->serial_number == 4321);
+    CHECK(!reader.Next());
+    CHECK(index->SerialRange(kEvents, kEvents + 10).Empty());
+}
+
+void testContentChecksum(const std::string& events) {
+    std::string frame = CompressLz4Frame(events, true);
+
+    {
+        // intact frame: read through, and entered at a later block
+        TempFile temp(frame, ".mid.lz4");
+        Lz4BlockReader reader(temp.Path());
+        std::vector<char> buf(4096);
+        uint64_t total = 0;
+        int rd;
+        while ((rd = reader.Read(buf.data(), static_cast<int>(buf.size()))) > 0) total += rd;
+        CHECK(!reader.fError);
+        CHECK(total == events.size());
+
+        auto index = std::make_shared<MidasEventIndex>(MidasEventIndex::Build(temp.Path()));
+        IndexedEventReader indexed(temp.Path(), index);
+        indexed.SetRange(index->Range(kEvents / 2, kEvents));
+        uint32_t count = 0;
+        while (indexed.Next()) ++count;
+        CHECK(!indexed.HasError());
+        CHECK(count == kEvents / 2);
+    }
+
+    // a wrong content checksum fails the read that reaches the frame end
+    frame[frame.size() - 1] ^= 0x55;
+    TempFile temp(frame, ".mid.lz4");
+    Lz4BlockReader reader(temp.Path());
+    std::vector<char> buf(4096);
+    while (reader.Read(buf.data(), static_cast<int>(buf.size())) > 0) {
+    }
+    CHECK(reader.fError);
+    CHECK(reader.fErrorString.find("content checksum") != std::string::npos);
+    CHECK_THROWS(MidasEventIndex::Build(temp.Path()), std::runtime_error);
+}
+
+} // namespace
+
+int main() {
+    spdlog::set_level(spdlog::level::err);
+    std::string events = MakeEventBytes(kEvents, serialAt);
+
+    TempFile plain(events, ".mid");
+    testSerialRange(plain.Path());
+    TempFile lz4(CompressLz4Frame(events, true), ".mid.lz4");
+    testSerialRange(lz4.Path());
+
+    testContentChecksum(events);
+
+    return TestExitCode();
+}
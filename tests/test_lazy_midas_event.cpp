@@ -0,0 +1,53 @@
+// LazyMidasEvent::GetBankJson() must give the same bank object as the
+// "banks" array of event_json, whatever form of the name the caller uses.
+// Lazy products count their banks in the stage metrics like eager ones.
+
+#include "analysis_pipeline/midas_event_unpacker/data_products/LazyMidasEvent.h"
+#include "analysis_pipeline/midas_event_unpacker/stages/midas_event_to_json_stage.h"
+#include "test_check.h"
+#include <nlohmann/json.hpp>
+#include <memory>
+#include <string>
+
+using json = nlohmann::json;
+
+int main() {
+    TMEvent built;
+    built.Init(1, 0, 7, 1700000000);
+    uint16_t adc[3] = {1, 2, 3};
+    float temp[2] = {20.5f, -1.0f};
+    built.AddBank("ADC\0", TID_UINT16, reinterpret_cast<const char*>(adc), sizeof(adc));  // 3-character name
+    built.AddBank("TEMP", TID_FLOAT, reinterpret_cast<const char*>(temp), sizeof(temp));
+    auto event = std::make_shared<TMEvent>(built.data.data(), built.data.size());
+
+    PipelineDataProductManager manager;
+    MidasEventToJsonStage stage;
+    stage.Init(json::object(), &manager);
+    TMEvent eagerEvent = *event;
+    json eager = json::parse(stage.SerializeEvent(eagerEvent));
+
+    dataProducts::LazyMidasEvent lazy;
+    lazy.Assign(event, std::make_shared<const BankSelection>());
+
+    auto adcJson = lazy.GetBankJson("ADC");
+    auto tempJson = lazy.GetBankJson("TEMP");
+    CHECK(adcJson && tempJson);
+    if (adcJson && tempJson) {
+        CHECK(*adcJson == eager["banks"][0].dump());
+        CHECK(*tempJson == eager["banks"][1].dump());
+    }
+    CHECK(!lazy.GetBankJson("NONE"));
+
+    MidasEventToJsonStage lazyStage;
+    lazyStage.Init(json{{"lazy_products", true}}, &manager);
+    InputBundle input;
+    input.set("TMEvent", event);
+    lazyStage.SetInput(input);
+    lazyStage.Process();
+    auto metrics = lazyStage.GetMetrics();
+    CHECK(metrics->banks == 2);
+    CHECK(metrics->bankBytes == sizeof(adc) + sizeof(temp));
+    CHECK(metrics->bankStats.size() == 2);
+
+    return TestExitCode();
+}
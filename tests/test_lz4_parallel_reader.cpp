@@ -0,0 +1,91 @@
+// Concatenated LZ4 frames with different flags must read the same with the
+// serial reader and with the parallel reader (TMLz4ReaderThreads > 1), whose
+// dispatcher runs ahead of Read() into the next frame.
+
+#include "midasio.h"
+#include "test_check.h"
+#include "test_fixtures.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+const uint32_t kEventsPerFrame = 20000;
+
+std::string makeSkippableFrame(uint32_t size) {
+    std::string frame("\x50\x2a\x4d\x18", 4);
+    frame.append(reinterpret_cast<const char*>(&size), 4);  // little endian hosts only, like the rest of midasio
+    frame.append(size, 'x');
+    return frame;
+}
+
+struct ReadResult {
+    uint32_t events = 0;
+    bool inOrder = true;
+    bool error = false;
+    std::string errorString;
+};
+
+ReadResult readAll(const std::string& path, int threads) {
+    TMLz4ReaderThreads = threads;
+    ReadResult result;
+    TMReaderInterface* reader = TMNewReader(path.c_str());
+    TMEvent event;
+    while (TMReadEvent(reader, &event)) {
+        if (event.serial_number != result.events) result.inOrder = false;
+        ++result.events;
+    }
+    result.error = reader->fError;
+    result.errorString = reader->fErrorString;
+    reader->Close();
+    delete reader;
+    TMLz4ReaderThreads = 0;
+    return result;
+}
+
+void checkAllThreadCounts(const std::string& file, const char* what) {
+    TempFile temp(file, ".lz4");
+    for (int threads : {0, 2, 4}) {
+        ReadResult result = readAll(temp.Path(), threads);
+        if (result.events != 3 * kEventsPerFrame || !result.inOrder || result.error) {
+            fprintf(stderr, "%s, %d reader threads: %u events, in order %d, error '%s'\n", what, threads,
+                    result.events, result.inOrder, result.errorString.c_str());
+        }
+        CHECK(result.events == 3 * kEventsPerFrame);
+        CHECK(result.inOrder);
+        CHECK(!result.error);
+    }
+}
+
+} // namespace
+
+int main() {
+    std::vector<std::string> data;
+    for (uint32_t frame = 0; frame < 3; ++frame) {
+        data.push_back(MakeEventBytes(frame * kEventsPerFrame, kEventsPerFrame));
+    }
+
+    auto frame = [&](int i, bool contentChecksum) { return CompressLz4Frame(data[i], contentChecksum); };
+
+    // like `cat a.lz4 b.lz4 c.lz4` of files written with and without content checksum
+    checkAllThreadCounts(frame(0, true) + frame(1, false) + frame(2, true), "checksum on/off/on");
+    checkAllThreadCounts(frame(0, false) + frame(1, true) + frame(2, false), "checksum off/on/off");
+
+    // skippable frames between and after data frames, one bigger than the read chunk
+    checkAllThreadCounts(frame(0, true) + makeSkippableFrame(100000) + frame(1, false) + makeSkippableFrame(0) +
+                             frame(2, true) + makeSkippableFrame(17),
+                         "skippable frames");
+
+    // a wrong content checksum in the last frame is still reported
+    std::string corrupt = frame(0, false) + frame(1, true) + frame(2, true);
+    corrupt[corrupt.size() - 1] ^= 0x55;
+    TempFile temp(corrupt, ".lz4");
+    for (int threads : {0, 2, 4}) {
+        ReadResult result = readAll(temp.Path(), threads);
+        CHECK(result.error);
+        CHECK(result.events <= 3 * kEventsPerFrame);
+    }
+
+    return TestExitCode();
+}
@@ -0,0 +1,134 @@
+// Files written by the LZ4 writer (TMNewLz4Writer) must read back byte for
+// byte with the serial and the parallel reader, for every writer thread
+// count and compression level, and write errors of the underlying file must
+// reach fError of the LZ4 writer, also when a writer thread hit them.
+
+#include "midasio.h"
+#include "test_check.h"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace {
+
+// About 10 MiB of events: compressible, then incompressible for more than one
+// 4 MiB block (stored uncompressed), then compressible again
+std::vector<TMEvent> makeEvents() {
+    std::vector<TMEvent> events;
+    std::mt19937 rng(4711);
+    uint32_t serial = 0;
+    auto add = [&](size_t bytes, bool random) {
+        for (size_t done = 0; done < bytes; ++serial) {
+            std::vector<uint32_t> payload(256 + serial % 512);
+            for (size_t i = 0; i < payload.size(); ++i) {
+                payload[i] = random ? rng() : static_cast<uint32_t>(serial + i % 16);
+            }
+            TMEvent event;
+            event.Init(1, 0, serial, 1700000000 + serial / 1000);
+            event.AddBank("DATA", TID_UINT32, reinterpret_cast<const char*>(payload.data()),
+                          payload.size() * sizeof(uint32_t));
+            done += event.data.size();
+            events.push_back(std::move(event));
+        }
+    };
+    add(3 << 20, false);
+    add(5 << 20, true);
+    add(2 << 20, false);
+    return events;
+}
+
+std::string tempPath() {
+    char name[] = "/tmp/test_lz4_writer_XXXXXX.mid.lz4";
+    int fd = mkstemps(name, 8);
+    if (fd < 0) {
+        perror("mkstemps");
+        abort();
+    }
+    close(fd);
+    return name;
+}
+
+bool writeAll(const std::string& path, std::vector<TMEvent>& events, int level, int threads,
+              std::string* error) {
+    TMWriterInterface* writer = TMNewLz4Writer(TMNewFileWriter(path.c_str()), level, true, threads);
+    for (TMEvent& event : events) {
+        TMWriteEvent(writer, &event);
+        if (writer->fError) break;
+    }
+    bool ok = writer->Close() == 0 && !writer->fError;
+    *error = writer->fErrorString;
+    delete writer;
+    return ok;
+}
+
+bool readBack(const std::string& path, const std::vector<TMEvent>& events, int threads, std::string* error) {
+    TMLz4ReaderThreads = threads;
+    TMReaderInterface* reader = TMNewReader(path.c_str());
+    TMEvent event;
+    size_t count = 0;
+    bool same = true;
+    while (TMReadEvent(reader, &event)) {
+        if (count >= events.size() || event.data != events[count].data) same = false;
+        ++count;
+    }
+    same = same && count == events.size() && !reader->fError;
+    *error = reader->fErrorString;
+    reader->Close();
+    delete reader;
+    TMLz4ReaderThreads = 0;
+    return same;
+}
+
+void testRoundTrip(std::vector<TMEvent>& events) {
+    std::string path = tempPath();
+    for (int writerThreads : {0, 2, 3}) {
+        for (int level : {1, -4, 9}) {  // fast, faster, HC
+            std::string error;
+            bool written = writeAll(path, events, level, writerThreads, &error);
+            if (!written) {
+                fprintf(stderr, "level %d, %d writer threads: write failed: %s\n", level, writerThreads,
+                        error.c_str());
+            }
+            CHECK(written);
+            for (int readerThreads : {0, 2, 4}) {
+                bool same = readBack(path, events, readerThreads, &error);
+                if (!same) {
+                    fprintf(stderr, "level %d, %d writer threads, %d reader threads: round trip failed '%s'\n",
+                            level, writerThreads, readerThreads, error.c_str());
+                }
+                CHECK(same);
+            }
+        }
+    }
+    unlink(path.c_str());
+}
+
+void testWriteErrors(std::vector<TMEvent>& events) {
+    for (int threads : {0, 2, 3}) {
+        // every write fails once the stdio buffer flushes
+        std::string error;
+        CHECK(!writeAll("/dev/full", events, 1, threads, &error));
+        CHECK(error.find("write error") != std::string::npos);
+
+        // fopen fails, the LZ4 writer reports it from the start
+        TMWriterInterface* writer =
+            TMNewLz4Writer(TMNewFileWriter("/nonexistent/test_lz4_writer.mid.lz4"), 1, true, threads);
+        CHECK(writer->fError);
+        TMWriteEvent(writer, &events[0]);
+        CHECK(writer->Close() != 0);
+        CHECK(writer->fErrorString.find("fopen") != std::string::npos);
+        delete writer;
+    }
+}
+
+} // namespace
+
+int main() {
+    std::vector<TMEvent> events = makeEvents();
+    testRoundTrip(events);
+    testWriteErrors(events);
+    return TestExitCode();
+}
@@ -0,0 +1,211 @@
+// The streaming JSON serializer of MidasEventToJsonStage must write exactly
+// the bytes of the nlohmann::json DOM path ("serializer": "dom"). Whole
+// events are serialized both ways and compared byte for byte, and the double
+// formatter is compared with dump() on its own.
+
+#include "analysis_pipeline/midas_event_unpacker/serialization/midas_json_writer.h"
+#include "analysis_pipeline/midas_event_unpacker/stages/midas_event_to_json_stage.h"
+#include "test_check.h"
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace {
+
+struct Bank {
+    std::string name;
+    int tid;
+    std::string data;
+};
+
+// Event bytes as a reader would deliver them
+TMEvent makeEvent(uint32_t serial, const std::vector<Bank>& banks) {
+    TMEvent built;
+    built.Init(1, 0x4, serial, 1700000000);
+    for (const Bank& bank : banks) {
+        built.AddBank(bank.name.c_str(), bank.tid, bank.data.data(), bank.data.size());
+    }
+    return TMEvent(built.data.data(), built.data.size());
+}
+
+template <typename T>
+std::string bytesOf(const std::vector<T>& values) {
+    return std::string(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+class Serializers {
+public:
+    Serializers() {
+        streaming_.Init(json{{"serializer", "streaming"}}, &manager_);
+        dom_.Init(json{{"serializer", "dom"}}, &manager_);
+    }
+
+    // Both serializers agree and the output parses
+    bool Same(TMEvent event, const char* what) {
+        TMEvent copy = event;
+        std::string streamed = streaming_.SerializeEvent(event);
+        std::string dumped = dom_.SerializeEvent(copy);
+        if (streamed != dumped) {
+            size_t at = 0;
+            while (at < streamed.size() && at < dumped.size() && streamed[at] == dumped[at]) ++at;
+            fprintf(stderr, "%s: outputs differ at byte %zu\n  streaming: %s\n  dom:       %s\n", what, at,
+                    streamed.substr(at > 40 ? at - 40 : 0, 120).c_str(), dumped.substr(at > 40 ? at - 40 : 0, 120).c_str());
+            return false;
+        }
+        try {
+            (void)json::parse(streamed);
+        } catch (const json::exception& e) {
+            fprintf(stderr, "%s: output does not parse: %s\n", what, e.what());
+            return false;
+        }
+        return true;
+    }
+
+    MidasEventToJsonStage& Streaming() { return streaming_; }
+    MidasEventToJsonStage& Dom() { return dom_; }
+
+private:
+    PipelineDataProductManager manager_;
+    MidasEventToJsonStage streaming_;
+    MidasEventToJsonStage dom_;
+};
+
+void testSpecialValues(Serializers& serializers) {
+    const float fnan = std::numeric_limits<float>::quiet_NaN();
+    const float finf = std::numeric_limits<float>::infinity();
+    const double dnan = std::numeric_limits<double>::quiet_NaN();
+    const double dinf = std::numeric_limits<double>::infinity();
+
+    std::vector<Bank> banks = {
+        {"FLT0", TID_FLOAT, bytesOf<float>({0.0f, -0.0f, 1.5f, -3.25e-7f, fnan, finf, -finf,
+                                            std::numeric_limits<float>::denorm_min(),
+                                            std::numeric_limits<float>::max(), 0.1f})},
+        {"DBL0", TID_DOUBLE, bytesOf<double>({0.0, -0.0, 0.1, 1e300, -1e-300, dnan, dinf, -dinf,
+                                              std::numeric_limits<double>::denorm_min(),
+                                              std::numeric_limits<double>::max(), 123456789.0})},
+        {"I8_0", TID_INT8, bytesOf<int8_t>({-128, -1, 0, 127})},
+        {"U8_0", TID_UINT8, bytesOf<uint8_t>({0, 1, 255})},
+        {"I16A", TID_INT16, bytesOf<int16_t>({-32768, 0, 32767})},
+        {"U16A", TID_UINT16, bytesOf<uint16_t>({0, 65535})},
+        {"I32A", TID_INT32, bytesOf<int32_t>({std::numeric_limits<int32_t>::min(), -1, 0,
+                                              std::numeric_limits<int32_t>::max()})},
+        {"U32A", TID_UINT32, bytesOf<uint32_t>({0, 0xffffffffu})},
+        {"I64A", TID_INT64, bytesOf<int64_t>({std::numeric_limits<int64_t>::min(), 0,
+                                              std::numeric_limits<int64_t>::max()})},
+        {"U64A", TID_UINT64, bytesOf<uint64_t>({0, std::numeric_limits<uint64_t>::max()})},
+        {"STR0", TID_STRING, std::string("plain ascii")},
+        {"STR1", TID_STRING, std::string("nul\0inside\0\0", 13)},
+        {"STR2", TID_STRING, std::string("quote \" backslash \\ tab \t newline \n bell \x07 del \x7f")},
+        {"STR3", TID_STRING, std::string("\xc2\xb5s, \xce\xa9, \xe2\x82\xac, \xf0\x9f\x98\x80")},  // µs, Ω, €, emoji
+        {"CHR0", TID_CHAR, std::string("abc")},
+        {"BOOL", TID_BOOL, bytesOf<uint32_t>({0, 1})},
+        {"STRU", TID_STRUCT, std::string("\x00\x01\xfe\xff", 4)},
+        {"EMPT", TID_UINT32, std::string()},
+        {std::string("AB\0\0", 4), TID_UINT16, bytesOf<uint16_t>({7})},  // short name, AddBank copies 4 bytes
+    };
+    CHECK(serializers.Same(makeEvent(1, banks), "special values"));
+    CHECK(serializers.Same(makeEvent(2, {}), "event without banks"));
+}
+
+void testInvalidUtf8(Serializers& serializers) {
+    // nlohmann::json refuses to dump invalid UTF-8; the streaming path must too
+    TMEvent event = makeEvent(3, {{"BAD0", TID_STRING, std::string("ok \xff\xfe not utf-8")}});
+    TMEvent copy = event;
+    CHECK_THROWS(serializers.Streaming().SerializeEvent(event), json::type_error);
+    CHECK_THROWS(serializers.Dom().SerializeEvent(copy), json::type_error);
+}
+
+// AppendDouble() against json(value).dump() directly, over far more values
+// than the events carry
+void testDoubles() {
+    std::mt19937_64 rng(8675309);
+    int mismatches = 0;
+    auto check = [&](double value) {
+        std::string out;
+        midas_json::AppendDouble(out, value);
+        std::string expected = json(value).dump();
+        if (out != expected && ++mismatches <= 5) {
+            fprintf(stderr, "AppendDouble(%a): '%s', dump() '%s'\n", value, out.c_str(), expected.c_str());
+        }
+    };
+
+    for (int i = 0; i < 2000000; ++i) {
+        uint64_t bits = rng();
+        double d;
+        std::memcpy(&d, &bits, sizeof(d));
+        check(d);  // every exponent, NaN and infinity included
+
+        uint32_t fbits = static_cast<uint32_t>(bits >> 32);
+        float f;
+        std::memcpy(&f, &fbits, sizeof(f));
+        check(static_cast<double>(f));  // TID_FLOAT banks are widened like this
+    }
+    // short decimals, integers and powers of ten, where the digit and
+    // exponent formatting switches
+    for (int i = -400; i <= 400; ++i) {
+        check(std::pow(10.0, i));
+        check(-std::pow(10.0, i) * 1.5);
+    }
+    for (int i = 0; i < 100000; ++i) {
+        check(i / 1000.0);
+        check(static_cast<double>(i) * 1e15);
+        check(static_cast<double>(static_cast<float>(i / 100.0)));
+    }
+    for (double d : {0.0, -0.0, 1.0, -1.0, 0.1, 0.5, 1e21, 1e22, 9007199254740993.0,
+                     std::numeric_limits<double>::min(), std::numeric_limits<double>::max(),
+                     std::numeric_limits<double>::denorm_min(), std::numeric_limits<double>::epsilon()}) {
+        check(d);
+    }
+    CHECK(mismatches == 0);
+}
+
+void testRandomEvents(Serializers& serializers) {
+    const int tids[] = {TID_UINT8, TID_INT8, TID_UINT16, TID_INT16, TID_UINT32, TID_INT32, TID_UINT64,
+                        TID_INT64, TID_FLOAT, TID_DOUBLE, TID_STRING, TID_CHAR, TID_BITFIELD, TID_STRUCT};
+    std::mt19937_64 rng(20240611);
+    auto pick = [&](size_t n) { return static_cast<size_t>(rng() % n); };
+
+    int mismatches = 0;
+    for (uint32_t serial = 0; serial < 2000 && mismatches < 5; ++serial) {
+        std::vector<Bank> banks(pick(12));
+        for (size_t i = 0; i < banks.size(); ++i) {
+            Bank& bank = banks[i];
+            bank.name = "B" + std::to_string(100 + i);
+            bank.tid = tids[pick(sizeof(tids) / sizeof(tids[0]))];
+            size_t size = pick(200);
+            if (bank.tid == TID_STRING) {
+                // printable ASCII and NULs, sometimes with escapes
+                for (size_t j = 0; j < size; ++j) {
+                    size_t c = pick(100);
+                    bank.data.push_back(c < 90 ? static_cast<char>(0x20 + c % 95) : (c < 95 ? '\0' : '"'));
+                }
+            } else {
+                // random bits cover every float class, NaN payloads included
+                for (size_t j = 0; j < size; ++j) bank.data.push_back(static_cast<char>(rng()));
+            }
+        }
+        if (!serializers.Same(makeEvent(serial, banks), "random event")) {
+            ++mismatches;
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+} // namespace
+
+int main() {
+    spdlog::set_level(spdlog::level::err);  // hex and empty banks warn on every event
+    Serializers serializers;
+    testSpecialValues(serializers);
+    testInvalidUtf8(serializers);
+    testDoubles();
+    testRandomEvents(serializers);
+    return TestExitCode();
+}
@@ -0,0 +1,51 @@
+// Events from TMMmapReader are read-only views of the mapped file. The
+// non-const accessors must still work on them: they copy the event into
+// TMEvent::data first, so writes never reach the file or other views.
+
+#include "midasio.h"
+#include "test_check.h"
+#include "test_fixtures.h"
+#include <cstring>
+#include <memory>
+#include <string>
+
+int main() {
+    const uint32_t kEvents = 10;
+    std::string events = MakeEventBytes(0, kEvents);
+    TempFile file(events, ".mid");
+
+    TMMmapReader reader(file.Path().c_str());
+    uint32_t count = 0;
+    while (auto event = reader.ReadEvent()) {
+        CHECK(event->IsView());
+        event->FindAllBanks();
+        CHECK(event->banks.size() == 1);
+        if (event->banks.empty()) break;
+        const TMBank& bank = event->banks[0];
+
+        char* data = event->GetBankData(&bank);
+        CHECK(data != nullptr);
+        CHECK(!event->IsView());
+        CHECK(event->GetEventData() != nullptr);
+        if (data) {
+            uint32_t first = 0;
+            std::memcpy(&first, data, sizeof(first));
+            CHECK(first == event->serial_number * 8);
+            std::memset(data, 0xff, bank.data_size);  // only the private copy changes
+        }
+        ++count;
+    }
+    CHECK(!reader.fError);
+    CHECK(count == kEvents);
+    reader.Close();
+
+    // the file and fresh views still hold the original bytes
+    TMMmapReader again(file.Path().c_str());
+    auto event = again.ReadEvent();
+    CHECK(event && event->IsView());
+    if (event) {
+        CHECK(std::memcmp(event->EventBytes(), events.data(), event->EventSize()) == 0);
+    }
+
+    return TestExitCode();
+}
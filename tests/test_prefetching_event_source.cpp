@@ -0,0 +1,50 @@
+// PrefetchingEventSource reads its file once, with the mmap reader and with
+// the stream reader. Starting it again, also after Stop(), must throw rather
+// than resume with the end-of-input flag and stats of the first pass.
+
+#include "analysis_pipeline/midas_event_unpacker/io/prefetching_event_source.h"
+#include "test_check.h"
+#include "test_fixtures.h"
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <string>
+
+int main() {
+    spdlog::set_level(spdlog::level::err);
+    const uint32_t kEvents = 1000;
+    TempFile file(MakeEventBytes(0, kEvents), ".mid");
+
+    for (bool useMmap : {true, false}) {
+        PrefetchingEventSource::Options options;
+        options.queueDepth = 16;
+        options.useMmap = useMmap;
+        PrefetchingEventSource source(file.Path(), options);
+        CHECK(!source.Next());  // not started
+
+        source.Start();
+        CHECK_THROWS(source.Start(), std::logic_error);
+        uint32_t count = 0;
+        bool inOrder = true;
+        while (auto event = source.Next()) {
+            if (event->serial_number != count) inOrder = false;
+            ++count;
+        }
+        CHECK(count == kEvents);
+        CHECK(inOrder);
+        CHECK(!source.HasError());
+        CHECK(source.GetStats().eventsConsumed == kEvents);
+
+        source.Stop();
+        CHECK_THROWS(source.Start(), std::logic_error);
+        CHECK(!source.Next());
+    }
+
+    // stopped part way: the source stays stopped
+    PrefetchingEventSource source(file.Path());
+    source.Start();
+    CHECK(source.Next());
+    source.Stop();
+    CHECK_THROWS(source.Start(), std::logic_error);
+
+    return TestExitCode();
+}
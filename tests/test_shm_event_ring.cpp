@@ -0,0 +1,125 @@
+// A producer process and a consumer process share an event ring. The
+// consumer unpacks with MidasEventToByteStreamStage, whose product manager
+// keeps the last product of every bank, so banks that appear only once pin
+// their slots for good. The ring must keep moving with more such banks than
+// slots and many more events than the ring holds, and a consumer must not
+// wait forever on a producer that died.
+
+#include "analysis_pipeline/midas_event_unpacker/io/shm_event_ring.h"
+#include "analysis_pipeline/midas_event_unpacker/io/shm_event_source.h"
+#include "analysis_pipeline/midas_event_unpacker/stages/midas_event_to_byte_stream_stage.h"
+#include "test_check.h"
+#include "test_fixtures.h"
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+#include <csignal>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+const uint32_t kSlots = 4;
+const uint64_t kSlotSize = 4096;
+const uint32_t kEvents = 3000;       // about 60 slots' worth
+const uint32_t kOnceBankEvery = 40;  // a bank that appears once, in most slots of the first 25
+const uint32_t kOnceBankUntil = 1000;
+
+std::string ringName() {
+    return "/test_shm_event_ring_" + std::to_string(getpid());
+}
+
+TMEvent makeEvent(uint32_t serial) {
+    TMEvent event;
+    event.Init(1, 0, serial, 1700000000);
+    uint32_t adc[4] = {serial, 1, 2, 3};
+    event.AddBank("ADC0", TID_UINT32, reinterpret_cast<const char*>(adc), sizeof(adc));
+    if (serial % kOnceBankEvery == 0 && serial < kOnceBankUntil) {
+        char name[5];
+        snprintf(name, sizeof(name), "O%03u", serial / kOnceBankEvery);
+        event.AddBank(name, TID_UINT32, reinterpret_cast<const char*>(adc), sizeof(adc));
+    }
+    return event;
+}
+
+// Child process: writes count events and closes the ring, or exits without
+// closing it (a crashed producer)
+void produce(const std::string& name, uint32_t count, bool close) {
+    alarm(60);  // a deadlock fails the test instead of hanging it
+    try {
+        ShmEventRingProducer ring(name, kSlots, kSlotSize);
+        for (uint32_t serial = 0; serial < count; ++serial) {
+            TMEvent event = makeEvent(serial);
+            ring.Write(event.EventBytes(), event.EventSize());
+        }
+        if (!close) {
+            ring.Flush();
+            _exit(0);
+        }
+        ring.Close();
+    } catch (const std::exception& e) {
+        fprintf(stderr, "producer: %s\n", e.what());
+        _exit(1);
+    }
+    _exit(0);
+}
+
+void testOnceSeenBanks() {
+    std::string name = ringName();
+    pid_t producer = fork();
+    if (producer == 0) produce(name, kEvents, true);
+    alarm(60);
+
+    PipelineDataProductManager manager;
+    MidasEventToByteStreamStage stage;
+    stage.Init(nlohmann::json::object(), &manager);
+
+    ShmEventSource source(name);
+    uint32_t count = 0;
+    bool inOrder = true;
+    while (auto event = source.Next()) {
+        if (event->serial_number != count) inOrder = false;
+        ++count;
+        ProcessEvent(stage, std::move(event));
+    }
+    CHECK(!source.HasError());
+    CHECK(count == kEvents);
+    CHECK(inOrder);
+    CHECK(source.GetStats().copiedEvents > 0);
+    CHECK(source.GetStats().copiedEvents < kEvents);
+
+    int status = 0;
+    CHECK(waitpid(producer, &status, 0) == producer);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    alarm(0);
+}
+
+void testProducerExits() {
+    // no zombie: the exited producer must look dead to the consumer
+    signal(SIGCHLD, SIG_IGN);
+    std::string name = ringName() + "_crash";
+    pid_t producer = fork();
+    if (producer == 0) produce(name, 10, false);
+    alarm(60);
+
+    ShmEventSource source(name);
+    uint32_t count = 0;
+    while (source.Next()) ++count;
+    CHECK(count == 10);
+    CHECK(source.HasError());
+    CHECK(source.ErrorString().find("exited") != std::string::npos);
+    shm_unlink(name.c_str());
+    alarm(0);
+}
+
+} // namespace
+
+int main() {
+    spdlog::set_level(spdlog::level::critical);  // the crash test logs an expected error
+    testOnceSeenBanks();
+    testProducerExits();
+    return TestExitCode();
+}
@@ -0,0 +1,46 @@
+// UnpackerMetricsRecorder keeps per-bank counters in a hash table whose free
+// slots have FOURCC 0. A bank whose name is all zeros (a zeroed or corrupt
+// bank header) must count as "????" and never share a slot with a real bank.
+
+#include "analysis_pipeline/midas_event_unpacker/instrumentation/unpacker_metrics_recorder.h"
+#include "midasio.h"
+#include "test_check.h"
+#include <cstdio>
+#include <string>
+
+int main() {
+#if MIDAS_UNPACKER_INSTRUMENTATION
+    UnpackerMetricsRecorder recorder;
+    recorder.BeginEventBanks();
+    recorder.CountBank(0, 1000);
+
+    // more names than the table holds, so every slot is taken by a real bank
+    const unsigned kNames = 300;
+    for (unsigned i = 0; i < kNames; ++i) {
+        char name[5];
+        snprintf(name, sizeof(name), "B%03u", i);
+        recorder.BeginEventBanks();
+        recorder.CountBank(TMFourCC(name), 8);
+    }
+
+    dataProducts::UnpackerMetrics metrics;
+    recorder.Snapshot(metrics);
+    CHECK(metrics.banks == kNames + 1);
+
+    unsigned named = 0;
+    bool sharedSlot = false;
+    uint64_t overflowBytes = 0;
+    for (const auto& bank : metrics.bankStats) {
+        if (bank.name == "????") {
+            overflowBytes = bank.bytes;
+            continue;
+        }
+        ++named;
+        if (bank.banks != 1 || bank.bytes != 8 || bank.events != 1) sharedSlot = true;
+    }
+    CHECK(!sharedSlot);
+    CHECK(named < kNames);
+    CHECK(overflowBytes == 1000 + (kNames - named) * 8);
+#endif
+    return TestExitCode();
+}